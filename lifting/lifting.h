@@ -22,7 +22,9 @@ V1.1: 23 January 2020
 #pragma once
 
 #include <vector>
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <stdint.h>
 
 namespace lifting
@@ -68,6 +70,282 @@ namespace lifting
       }
     }
 
+  /*
+  Range variants of the lifting steps.
+  Only the pairs i in [first, last) are lifted, where pair i consists of the even sample (2i << level) and the odd
+  sample ((2i+1) << level). The buffer 'sample' holds the samples from position sample_offset on, so that a window of
+  a longer signal of n samples can be processed. The borders are treated as the borders of the full signal, so the
+  window must contain every sample that the lifted pairs read (see predict_reach and update_reach).
+  Cyclical buffers need the full signal (sample_offset == 0).
+  */
+  template <typename T>
+  void scale_even_range(T* sample, uint64_t n, double s, uint64_t level, int64_t only_scale_away_from_border, uint64_t stride, bool cyclical, uint64_t first, uint64_t last, uint64_t sample_offset = 0)
+    {
+    assert(is_multiple_of_power_of_two(n, level));
+    const int64_t max_i = (int64_t)(n >> (level + 1));
+    const int64_t border = cyclical ? 0 : only_scale_away_from_border;
+    const int64_t i_begin = std::max<int64_t>((int64_t)first, border);
+    const int64_t i_end = std::min<int64_t>((int64_t)last, max_i - border);
+    for (int64_t i = i_begin; i < i_end; ++i)
+      {
+      const int64_t idx = (i << (int64_t)(level + 1)) - (int64_t)sample_offset;
+      sample[idx*stride] = (T)(sample[idx*stride] * s);
+      }
+    }
+
+  template <typename T>
+  void scale_odd_range(T* sample, uint64_t n, double s, uint64_t level, int64_t only_scale_away_from_border, uint64_t stride, bool cyclical, uint64_t first, uint64_t last, uint64_t sample_offset = 0)
+    {
+    assert(is_multiple_of_power_of_two(n, level));
+    const int64_t max_i = (int64_t)(n >> (level + 1));
+    const int64_t border = cyclical ? 0 : only_scale_away_from_border;
+    const int64_t i_begin = std::max<int64_t>((int64_t)first, border);
+    const int64_t i_end = std::min<int64_t>((int64_t)last, max_i - border);
+    for (int64_t i = i_begin; i < i_end; ++i)
+      {
+      const int64_t idx = (((i << 1) + 1) << (int64_t)level) - (int64_t)sample_offset;
+      sample[idx*stride] = (T)(sample[idx*stride] * s);
+      }
+    }
+
+  template <typename T>
+  void iscale_even_range(T* sample, uint64_t n, double s, uint64_t level, int64_t only_scale_away_from_border, uint64_t stride, bool cyclical, uint64_t first, uint64_t last, uint64_t sample_offset = 0)
+    {
+    assert(is_multiple_of_power_of_two(n, level));
+    const int64_t max_i = (int64_t)(n >> (level + 1));
+    const int64_t border = cyclical ? 0 : only_scale_away_from_border;
+    const int64_t i_begin = std::max<int64_t>((int64_t)first, border);
+    const int64_t i_end = std::min<int64_t>((int64_t)last, max_i - border);
+    for (int64_t i = i_begin; i < i_end; ++i)
+      {
+      const int64_t idx = (i << (int64_t)(level + 1)) - (int64_t)sample_offset;
+      sample[idx*stride] = (T)(sample[idx*stride] / s);
+      }
+    }
+
+  template <typename T>
+  void iscale_odd_range(T* sample, uint64_t n, double s, uint64_t level, int64_t only_scale_away_from_border, uint64_t stride, bool cyclical, uint64_t first, uint64_t last, uint64_t sample_offset = 0)
+    {
+    assert(is_multiple_of_power_of_two(n, level));
+    const int64_t max_i = (int64_t)(n >> (level + 1));
+    const int64_t border = cyclical ? 0 : only_scale_away_from_border;
+    const int64_t i_begin = std::max<int64_t>((int64_t)first, border);
+    const int64_t i_end = std::min<int64_t>((int64_t)last, max_i - border);
+    for (int64_t i = i_begin; i < i_end; ++i)
+      {
+      const int64_t idx = (((i << 1) + 1) << (int64_t)level) - (int64_t)sample_offset;
+      sample[idx*stride] = (T)(sample[idx*stride] / s);
+      }
+    }
+
+  /*
+  A predict step with a mask of mask_size values lifts the odd sample of pair i with the even samples of
+  pairs [i - left, i + right].
+  */
+  inline void predict_reach(uint64_t mask_size, int64_t& left, int64_t& right)
+    {
+    const int64_t offset = -(int64_t)(mask_size >> 1) + 1;
+    left = mask_size ? std::max<int64_t>(0, -offset) : 0;
+    right = mask_size ? std::max<int64_t>(0, (int64_t)mask_size - 1 + offset) : 0;
+    }
+
+  /*
+  An update step with a mask of mask_size values lifts the even sample of pair i with the odd samples of
+  pairs [i - left, i + right].
+  */
+  inline void update_reach(uint64_t mask_size, int64_t& left, int64_t& right)
+    {
+    const int64_t offset = -(int64_t)(mask_size >> 1) + 1;
+    left = mask_size ? std::max<int64_t>(0, 1 - offset) : 0;
+    right = mask_size ? std::max<int64_t>(0, (int64_t)mask_size - 2 + offset) : 0;
+    }
+
+  template <typename T>
+  void predict_range(T* sample, uint64_t n, const std::vector<double>& mask, uint64_t level, uint64_t stride, bool cyclical, uint64_t first, uint64_t last, uint64_t sample_offset = 0)
+    {
+    assert(is_multiple_of_power_of_two(n, level));
+    assert(!cyclical || sample_offset == 0);
+    const uint64_t max_i = n >> (level + 1);
+    const int64_t offset = -(int64_t)(mask.size() >> 1) + 1;
+    const int64_t so = (int64_t)sample_offset;
+    const int64_t i_end = std::min<int64_t>((int64_t)last, (int64_t)max_i);
+    if (cyclical)
+      {
+      for (int64_t i = (int64_t)first; i < i_end; ++i)
+        {
+        double prediction = 0.0;
+        for (int64_t j = 0; j < (int64_t)mask.size(); ++j)
+          {
+          int64_t coeff = (i + j + offset) << (int64_t)(level + 1);
+          if (coeff < 0)
+            coeff += (int64_t)n;
+          else if (coeff >= (int64_t)n)
+            coeff -= (int64_t)n;
+          prediction += mask[j] * sample[coeff*stride];
+          }
+        sample[(((i << 1) + 1) << level)*stride] -= (T)prediction;
+        }
+      }
+    else
+      {
+      const int64_t max_coeff = (max_i - 1) << (int64_t)(level + 1);
+      for (int64_t i = (int64_t)first; i < i_end; ++i)
+        {
+        double prediction = 0.0;
+        for (int64_t j = 0; j < (int64_t)mask.size(); ++j)
+          {
+          int64_t coeff = (i + j + offset) << (int64_t)(level + 1);
+          if (coeff < 0)
+            coeff = 0;
+          else if (coeff >= (int64_t)n)
+            coeff = max_coeff;
+          prediction += mask[j] * sample[(coeff - so)*stride];
+          }
+        sample[((((i << 1) + 1) << level) - so)*stride] -= (T)prediction;
+        }
+      }
+    }
+
+  template <typename T>
+  void ipredict_range(T* sample, uint64_t n, const std::vector<double>& mask, uint64_t level, uint64_t stride, bool cyclical, uint64_t first, uint64_t last, uint64_t sample_offset = 0)
+    {
+    assert(is_multiple_of_power_of_two(n, level));
+    assert(!cyclical || sample_offset == 0);
+    const uint64_t max_i = n >> (level + 1);
+    const int64_t offset = -(int64_t)(mask.size() >> 1) + 1;
+    const int64_t so = (int64_t)sample_offset;
+    const int64_t i_end = std::min<int64_t>((int64_t)last, (int64_t)max_i);
+    if (cyclical)
+      {
+      for (int64_t i = (int64_t)first; i < i_end; ++i)
+        {
+        double prediction = 0.0;
+        for (int64_t j = 0; j < (int64_t)mask.size(); ++j)
+          {
+          int64_t coeff = (i + j + offset) << (int64_t)(level + 1);
+          if (coeff < 0)
+            coeff += n;
+          else if (coeff >= (int64_t)n)
+            coeff -= n;
+          prediction += mask[j] * sample[coeff*stride];
+          }
+        sample[(((i << 1) + 1) << level)*stride] += (T)prediction;
+        }
+      }
+    else
+      {
+      const int64_t max_coeff = (max_i - 1) << (int64_t)(level + 1);
+      for (int64_t i = (int64_t)first; i < i_end; ++i)
+        {
+        double prediction = 0.0;
+        for (int64_t j = 0; j < (int64_t)mask.size(); ++j)
+          {
+          int64_t coeff = (i + j + offset) << (int64_t)(level + 1);
+          if (coeff < 0)
+            coeff = 0;
+          else if (coeff >= (int64_t)n)
+            coeff = max_coeff;
+          prediction += mask[j] * sample[(coeff - so)*stride];
+          }
+        sample[((((i << 1) + 1) << level) - so)*stride] += (T)prediction;
+        }
+      }
+    }
+
+  template <typename T>
+  void update_range(T* sample, uint64_t n, const std::vector<double>& mask, uint64_t level, uint64_t stride, bool cyclical, uint64_t first, uint64_t last, uint64_t sample_offset = 0)
+    {
+    assert(is_multiple_of_power_of_two(n, level));
+    assert(!cyclical || sample_offset == 0);
+    const uint64_t max_i = (n >> (level + 1));
+    const int64_t offset = -(int64_t)(mask.size() >> 1) + 1;
+    const int64_t so = (int64_t)sample_offset;
+    const int64_t i_end = std::min<int64_t>((int64_t)last, (int64_t)max_i);
+    if (cyclical)
+      {
+      for (int64_t i = (int64_t)first; i < i_end; ++i)
+        {
+        double upd = 0.0;
+        for (int64_t j = 0; j < (int64_t)mask.size(); ++j)
+          {
+          int64_t coeff = (((i + j + offset) << 1) - 1) << (int64_t)(level);
+          if (coeff < 0)
+            coeff += (int64_t)n;
+          else if (coeff >= (int64_t)n)
+            coeff -= (int64_t)n;
+          upd += mask[j] * sample[coeff*stride];
+          }
+        sample[(i << (level + 1))*stride] += (T)upd;
+        }
+      }
+    else
+      {
+      const int64_t min_coeff = (int64_t)1 << (int64_t)(level);
+      const int64_t max_coeff = ((max_i << 1) - 1) << (int64_t)(level);
+      for (int64_t i = std::max<int64_t>(1, (int64_t)first); i < i_end; ++i)
+        {
+        double upd = 0.0;
+        for (int64_t j = 0; j < (int64_t)mask.size(); ++j)
+          {
+          int64_t coeff = (((i + j + offset) << 1) - 1) << (int64_t)(level);
+          if (coeff < 0)
+            coeff = min_coeff;
+          else if (coeff >= (int64_t)n)
+            coeff = max_coeff;
+          upd += mask[j] * sample[(coeff - so)*stride];
+          }
+        sample[((i << (level + 1)) - so)*stride] += (T)upd;
+        }
+      }
+    }
+
+  template <typename T>
+  void iupdate_range(T* sample, uint64_t n, const std::vector<double>& mask, uint64_t level, uint64_t stride, bool cyclical, uint64_t first, uint64_t last, uint64_t sample_offset = 0)
+    {
+    assert(is_multiple_of_power_of_two(n, level));
+    assert(!cyclical || sample_offset == 0);
+    const uint64_t max_i = (n >> (level + 1));
+    const int64_t offset = -(int64_t)(mask.size() >> 1) + 1;
+    const int64_t so = (int64_t)sample_offset;
+    const int64_t i_end = std::min<int64_t>((int64_t)last, (int64_t)max_i);
+    if (cyclical)
+      {
+      for (int64_t i = (int64_t)first; i < i_end; ++i)
+        {
+        double upd = 0.0;
+        for (int64_t j = 0; j < (int64_t)mask.size(); ++j)
+          {
+          int64_t coeff = (((i + j + offset) << 1) - 1) << (int64_t)(level);
+          if (coeff < 0)
+            coeff += n;
+          else if (coeff >= (int64_t)n)
+            coeff -= n;
+          upd += mask[j] * sample[coeff*stride];
+          }
+        sample[(i << (level + 1))*stride] -= (T)upd;
+        }
+      }
+    else
+      {
+      const int64_t min_coeff = (int64_t)1 << (int64_t)(level);
+      const int64_t max_coeff = ((max_i << 1) - 1) << (int64_t)(level);
+      for (int64_t i = std::max<int64_t>(1, (int64_t)first); i < i_end; ++i)
+        {
+        double upd = 0.0;
+        for (int64_t j = 0; j < (int64_t)mask.size(); ++j)
+          {
+          int64_t coeff = (((i + j + offset) << 1) - 1) << (int64_t)(level);
+          if (coeff < 0)
+            coeff = min_coeff;
+          else if (coeff >= (int64_t)n)
+            coeff = max_coeff;
+          upd += mask[j] * sample[(coeff - so)*stride];
+          }
+        sample[((i << (level + 1)) - so)*stride] -= (T)upd;
+        }
+      }
+    }
+
   /*
   The predict stencil is defined by double mask.
   The left and right odd points are predicted with the same stencil value (mask)
@@ -1,4 +1,6 @@
 #include "sobolev.h"
+#include <map>
+#include <mutex>
 #include <numeric>
 
 jtk::mat transop(const std::vector<double>& p)
@@ -27,20 +29,8 @@ jtk::mat transop(const std::vector<double>& p)
   return T;
   }
 
-namespace
-  {
-  double factorial(int f)
-    {
-    int fact = 1;
-    for (int i = 2; i <= f; ++i)
-      fact = fact * i;
-    return (double)fact;
-    }
-  }
-
 void sumruleorder(int& SLO, double& P0, const std::vector<double>& p)
   {
-  std::vector<double> ELp = { {1.0, -1.0} };
   const int N = (int)p.size() - 1;
   const int m = 2;
   std::vector<double> P = p;
@@ -49,12 +39,11 @@ void sumruleorder(int& SLO, double& P0, const std::vector<double>& p)
   SLO = 0;
   std::vector<double> PP((size_t)m, 0.0);
 
+  // (-1)^j2 alternates, ELp = {1, -1}
   for (int j1 = 0; j1 <= N; ++j1)
     {
-    for (int k = 0; k < m; ++k)
-      {
-      PP[k] = PP[k] + pow(ELp[k], j1)*P[j1];
-      }
+    PP[0] = PP[0] + P[j1];
+    PP[1] = PP[1] + ((j1 & 1) ? -P[j1] : P[j1]);
     }
   P0 = PP[0];
   if (std::abs(P0 - 1.0) > 1e-4)
@@ -65,22 +54,23 @@ void sumruleorder(int& SLO, double& P0, const std::vector<double>& p)
   if (std::abs(vpp) > error)
     throw std::logic_error("Mask does not satisfy the sum rule of order 1");
   SLO = 1;
-  int slo0 = 10;
-  int k0 = slo0;
+  const int slo0 = 10;
+  const int k0 = slo0;
   jtk::mat DP = jtk::zeros(k0 + 1, m);
   DP(0, 1) = PP[1];
   jtk::mat y = jtk::zeros(k0 + 1, 1);
   y(0) = 1.0;
 
-
+  // the moments sum_j j^i2 (+-1)^j P[j], the powers j^i2 are kept per j and are exact integers
+  std::vector<double> power((size_t)N + 1, 1.0);
   for (int i2 = 0; i2 <= k0; ++i2)
     {
-    for (int k = 1; k <= m; ++k)
+    for (int j2 = 0; j2 <= N; ++j2)
       {
-      for (int j2 = 0; j2 <= N; ++j2)
-        {
-        DP(i2, k - 1) += pow((double)j2, (double)i2) * pow(ELp[k - 1], (double)j2) * P[j2];
-        }
+      const double term = power[j2] * P[j2];
+      DP(i2, 0) += term;
+      DP(i2, 1) += (j2 & 1) ? -term : term;
+      power[j2] *= (double)j2;
       }
     }
   //check sumrule order 2
@@ -91,6 +81,17 @@ void sumruleorder(int& SLO, double& P0, const std::vector<double>& p)
     return;
   SLO = 2;
 
+  // binomial coefficients and powers of m
+  double binomial[k0 + 1][k0 + 1];
+  double m_power[k0 + 1];
+  for (int s = 0; s <= k0; ++s)
+    {
+    m_power[s] = s == 0 ? 1.0 : m_power[s - 1] * m;
+    binomial[s][0] = binomial[s][s] = 1.0;
+    for (int g = 1; g < s; ++g)
+      binomial[s][g] = binomial[s - 1][g - 1] + binomial[s - 1][g];
+    }
+
   //check sum rule order greater than 2 
   jtk::mat lesssum00r = jtk::zeros(m, 1);
   for (int s = 2; s <= k0; ++s)
@@ -99,11 +100,12 @@ void sumruleorder(int& SLO, double& P0, const std::vector<double>& p)
     for (int k = 1; k <= m; ++k)
       {
       for (int ga1 = 0; ga1 < s; ++ga1)
-        {        
-        lesssum00r(k - 1) += factorial(s) / (factorial(ga1)*factorial(s - ga1))*pow(m, ga1)*pow(-1, s - ga1)*y(ga1)*DP(s - ga1, k - 1);
+        {
+        const double sign = ((s - ga1) & 1) ? -1.0 : 1.0;
+        lesssum00r(k - 1) += binomial[s][ga1]*m_power[ga1]*sign*y(ga1)*DP(s - ga1, k - 1);
         }
-      y(s) = lesssum00r(0) / (1.0 - pow(m, s) * P0);
-      sumpir(k - 1) = lesssum00r(k - 1) + pow(m, s)*y(s)*PP[k - 1];
+      y(s) = lesssum00r(0) / (1.0 - m_power[s] * P0);
+      sumpir(k - 1) = lesssum00r(k - 1) + m_power[s]*y(s)*PP[k - 1];
       }
     double sumpirmax = std::abs(sumpir(1));
     if (sumpirmax > error)
@@ -136,24 +138,101 @@ namespace
     }
   }
 
+namespace
+  {
+  // appends the eigenvalues of A, complex eigenvalues are appended as zero
+  void append_real_eigenvalues(std::vector<double>& values, const jtk::mat& A)
+    {
+    if (A.rows() == 0)
+      return;
+    jtk::mat wr, wi;
+    jtk::eig(A, wr, wi);
+    for (uint32_t j = 0; j < wr.rows(); ++j)
+      values.push_back(std::abs(wi(j)) > 1e-6 ? 0.0 : wr(j));
+    }
+
+  /*
+  The eigenvalues of transop(p), complex ones as zero.
+  transop(p)(i, j) = a(2i - j)/2 for i, j in [-N, N], with a the autocorrelation of p, which is symmetric. So the
+  operator commutes with the reflection i -> -i and splits in a part on the even and a part on the odd vectors.
+  Row N of each part only has its diagonal entry a(N)/2, which is an eigenvalue, and the rest of the spectrum is that
+  of the leading block. This gives eigen decompositions of size N and N - 1 instead of one of size 2N + 1.
+  */
+  std::vector<double> transop_eigenvalues(const std::vector<double>& p)
+    {
+    const int N = (int)p.size() - 1;
+    std::vector<double> a((size_t)(2 * N + 1), 0.0);
+    for (int j1 = 0; j1 < 2 * N + 1; ++j1)
+      {
+      for (int ell1 = std::max<int>(0, j1 - N); ell1 <= std::min<int>(N, j1); ++ell1)
+        a[j1] += p[N + ell1 - j1] * p[ell1];
+      }
+    auto t = [&](int k)
+      {
+      return (k < -N || k > N) ? 0.0 : a[k + N] / 2.0;
+      };
+    std::vector<double> values;
+    if (N == 0)
+      {
+      values.push_back(t(0));
+      return values;
+      }
+    values.push_back(t(N));
+    values.push_back(t(N));
+    jtk::mat even(N, N);
+    for (int i = 0; i < N; ++i)
+      {
+      even(i, 0) = t(2 * i);
+      for (int j = 1; j < N; ++j)
+        even(i, j) = t(2 * i - j) + t(2 * i + j);
+      }
+    append_real_eigenvalues(values, even);
+    jtk::mat odd(N - 1, N - 1);
+    for (int i = 1; i < N; ++i)
+      {
+      for (int j = 1; j < N; ++j)
+        odd(i - 1, j - 1) = t(2 * i - j) - t(2 * i + j);
+      }
+    append_real_eigenvalues(values, odd);
+    return values;
+    }
+
+  // the scheme tools evaluate the same masks repeatedly, from several threads
+  std::mutex sobolev_cache_mutex;
+  std::map<std::vector<double>, double> sobolev_cache;
+  const size_t max_sobolev_cache_size = 1 << 14;
+
+  bool find_cached(const std::vector<double>& P, double& reg)
+    {
+    std::lock_guard<std::mutex> lock(sobolev_cache_mutex);
+    auto it = sobolev_cache.find(P);
+    if (it == sobolev_cache.end())
+      return false;
+    reg = it->second;
+    return true;
+    }
+
+  void store_cached(const std::vector<double>& P, double reg)
+    {
+    std::lock_guard<std::mutex> lock(sobolev_cache_mutex);
+    if (sobolev_cache.size() >= max_sobolev_cache_size)
+      sobolev_cache.clear();
+    sobolev_cache[P] = reg;
+    }
+  }
+
 double sobsmthest(const std::vector<double>& P)
   {
   double reg = 0.0;
+  if (find_cached(P, reg))
+    return reg;
   int SLO;
   double P_0;
   sumruleorder(SLO, P_0, P);
-  auto T = transop(P);
 
   int vsize = 2 * SLO;
 
-  jtk::mat wr, wi;
-  jtk::eig(T, wr, wi);
-
-  for (uint32_t j = 0; j < wr.rows(); ++j)
-    {
-    if (std::abs(wi(j)) > 1e-6)
-      wr(j) = 0.0;
-    }
+  std::vector<double> wr = transop_eigenvalues(P);
   
   std::vector<double> sreigvalue;
   std::vector<size_t> od;
@@ -161,7 +240,7 @@ double sobsmthest(const std::vector<double>& P)
 
   std::vector<double> bigreig((size_t)vsize);
   for (size_t i = 0; i < (size_t)vsize; ++i)
-    bigreig[i] = wr((uint32_t)od[i + 1]);
+    bigreig[i] = wr[od[i + 1]];
 
   std::vector<double> eigen1((size_t)vsize, 0.0);
   for (int j = 0; j < 2 * SLO - 1; ++j)
@@ -201,5 +280,6 @@ double sobsmthest(const std::vector<double>& P)
     }
   reg = std::max<double>(std::abs(bigreig[j0]), std::abs(bigreig[j_0]));
   reg = -log(reg) / log(2.0) / 2.0;
+  store_cached(P, reg);
   return reg;
   }
\ No newline at end of file
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "imgui.h"
+
+class AppLog
+  {
+  public:
+    void Clear();
+    void AddLog(const char* fmt, ...) IM_FMTARGS(2);
+    void Draw(const char* title, bool* p_open = NULL);
+
+  private:
+    ImGuiTextBuffer     Buf;
+    ImGuiTextFilter     Filter;
+    ImVector<int>       LineOffsets;        // Index to lines offset
+    bool                ScrollToBottom;
+  };
@@ -0,0 +1,157 @@
+#include "batch_analysis.h"
+#include "model.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#include <json.hpp>
+
+namespace
+  {
+  std::mutex analysis_cache_mutex;
+  std::map<std::vector<double>, scheme_analysis> analysis_cache;
+  const size_t max_analysis_cache_size = 1 << 12;
+
+  // the steps as one vector, equal keys are equal schemes
+  std::vector<double> cache_key(const std::vector<lifting_step>& steps)
+    {
+    std::vector<double> key;
+    for (const auto& step : steps)
+      {
+      key.push_back((double)step.type);
+      key.push_back((double)step.only_scale_away_from_border);
+      key.push_back((double)step.mask.size());
+      key.insert(key.end(), step.mask.begin(), step.mask.end());
+      }
+    return key;
+    }
+
+  bool find_cached(const std::vector<double>& key, scheme_analysis& a)
+    {
+    std::lock_guard<std::mutex> lock(analysis_cache_mutex);
+    auto it = analysis_cache.find(key);
+    if (it == analysis_cache.end())
+      return false;
+    a = it->second;
+    return true;
+    }
+
+  void store_cached(const std::vector<double>& key, const scheme_analysis& a)
+    {
+    std::lock_guard<std::mutex> lock(analysis_cache_mutex);
+    if (analysis_cache.size() >= max_analysis_cache_size)
+      analysis_cache.clear();
+    analysis_cache[key] = a;
+    }
+
+  std::string make_record(const std::string& name, const std::vector<lifting_step>& steps, const scheme_analysis& a)
+    {
+    nlohmann::json j;
+    j["name"] = name;
+    j["steps"] = steps.size();
+    j["scaling"] = a.scaling;
+    j["dual_scaling"] = a.dual_scaling;
+    j["wavelet"] = a.wavelet;
+    j["scaling_sum"] = a.scaling_sum;
+    j["wavelet_sum"] = a.wavelet_sum;
+    if (a.wavelet_sum)
+      j["vanishing_moment_update"] = a.update_mask_value;
+    else
+      j["vanishing_moment_update"] = nullptr;
+    j["sob"] = a.sob; // NaN is written as null
+    j["sob_dual"] = a.sob_dual;
+    if (a.sob_error.empty())
+      j["sob_error"] = nullptr;
+    else
+      j["sob_error"] = a.sob_error;
+    if (a.sob_dual_error.empty())
+      j["sob_dual_error"] = nullptr;
+    else
+      j["sob_dual_error"] = a.sob_dual_error;
+    j["riesz"] = { -a.sob_dual, a.sob };
+    return j.dump();
+    }
+
+  std::string make_error_record(const std::string& name, const std::string& error)
+    {
+    nlohmann::json j;
+    j["name"] = name;
+    j["error"] = error;
+    return j.dump();
+    }
+
+  std::string analyze_one(const batch_scheme& bs)
+    {
+    std::vector<lifting_step> steps;
+    try
+      {
+      compile(steps, bs.script);
+      if (steps.empty())
+        throw std::logic_error("the script has no steps");
+      const std::vector<double> key = cache_key(steps);
+      scheme_analysis a;
+      if (!find_cached(key, a))
+        {
+        a = analyze_scheme(custom, steps);
+        store_cached(key, a);
+        }
+      return make_record(bs.name, steps, a);
+      }
+    catch (std::exception& e)
+      {
+      return make_error_record(bs.name, e.what());
+      }
+    }
+  }
+
+std::vector<batch_scheme> read_scheme_folder(const std::string& folder)
+  {
+  std::vector<batch_scheme> schemes;
+  for (const auto& entry : std::filesystem::directory_iterator(folder))
+    {
+    if (!entry.is_regular_file() || entry.path().extension() != ".txt")
+      continue;
+    std::ifstream t(entry.path());
+    if (!t)
+      throw std::runtime_error("cannot open " + entry.path().string());
+    schemes.emplace_back();
+    schemes.back().name = entry.path().stem().string();
+    schemes.back().script.assign(std::istreambuf_iterator<char>(t), std::istreambuf_iterator<char>());
+    }
+  std::sort(schemes.begin(), schemes.end(), [](const batch_scheme& left, const batch_scheme& right) { return left.name < right.name; });
+  return schemes;
+  }
+
+std::vector<std::string> analyze_batch(const std::vector<batch_scheme>& schemes, const std::function<void(double)>& report)
+  {
+  std::vector<std::string> records(schemes.size());
+  // in chunks of a few schemes per core, so that progress is reported from this thread
+  const uint64_t chunk_size = 4 * std::max<uint64_t>(1, (uint64_t)std::thread::hardware_concurrency());
+  for (uint64_t first = 0; first < schemes.size(); first += chunk_size)
+    {
+    if (report)
+      report((double)first / (double)schemes.size());
+    parallel_for(first, std::min<uint64_t>(first + chunk_size, schemes.size()), [&](uint64_t i)
+      {
+      records[i] = analyze_one(schemes[i]);
+      });
+    }
+  if (report)
+    report(1.0);
+  return records;
+  }
+
+void write_batch_report(const std::string& filename, const std::vector<std::string>& records)
+  {
+  std::ofstream f(filename);
+  if (!f)
+    throw std::runtime_error("cannot write " + filename);
+  for (const auto& r : records)
+    f << r << "\n";
+  }
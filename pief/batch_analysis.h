@@ -0,0 +1,31 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+/*
+Analysis of many custom scripts at once, e.g. the scripts in pief/wavelets and generated variants of them.
+
+Every scheme gets the analysis of analyze_scheme, computed in parallel and without logging, and the result is one
+JSON record (a single line) per scheme. A script that does not compile gets a record with its error, and a
+smoothness that can not be estimated is null with the reason in "sob_error" or "sob_dual_error". Results are
+cached by the steps of the scheme, so a scheme that was analyzed before, in this batch or an earlier one, is not
+analyzed again.
+*/
+
+struct batch_scheme
+  {
+  std::string name;
+  std::string script;
+  };
+
+// the *.txt files in the folder, sorted by name, named after the file without extension
+std::vector<batch_scheme> read_scheme_folder(const std::string& folder);
+
+// one JSON record per scheme, in the order of the schemes
+// report gets the progress in [0, 1], it may throw to abandon the analysis
+std::vector<std::string> analyze_batch(const std::vector<batch_scheme>& schemes, const std::function<void(double)>& report = std::function<void(double)>());
+
+// writes the records as JSON lines
+void write_batch_report(const std::string& filename, const std::vector<std::string>& records);
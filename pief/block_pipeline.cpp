@@ -0,0 +1,304 @@
+#include "block_pipeline.h"
+#include "bounded_queue.h"
+#include "mapped_file.h"
+
+#include "../lifting/lifting.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+namespace
+  {
+  typedef std::chrono::steady_clock clock_type;
+
+  struct block_job
+    {
+    uint32_t buffer;
+    uint32_t file;
+    uint64_t block;
+    uint64_t samples; // valid samples, the rest of the buffer repeats the last one
+    };
+
+  struct output_file
+    {
+    mapped_file output;
+    std::atomic<uint64_t> blocks_left{0};
+    std::atomic<uint64_t> compressed{0};
+    };
+
+  // what one thread of a stage did
+  struct thread_counters
+    {
+    uint64_t blocks = 0;
+    uint64_t bytes = 0;
+    double busy_seconds = 0.0;
+    double finished_seconds = 0.0;
+    };
+
+  double seconds_since(clock_type::time_point start)
+    {
+    return std::chrono::duration<double>(clock_type::now() - start).count();
+    }
+
+  class block_executor
+    {
+    public:
+      block_executor(const std::vector<std::string>& inputs, const std::vector<std::string>& outputs, const block_pipeline_settings& settings) :
+        _inputs(inputs), _outputs(outputs), _settings(settings), _block_size((uint64_t)1 << settings.block_levels),
+        _files(inputs.size()), _results(inputs.size()), _next_file(0), _aborted(false)
+        {
+        const uint32_t threads = settings.reader_threads + settings.forward_threads + settings.threshold_threads + settings.inverse_threads + settings.writer_threads;
+        const uint32_t buffers = settings.buffers ? settings.buffers : 2 * threads;
+        _buffers.resize(buffers);
+        _free = std::make_unique<bounded_queue<uint32_t>>(buffers);
+        for (uint32_t i = 0; i < buffers; ++i)
+          {
+          _buffers[i].resize(_block_size);
+          _free->push(i);
+          }
+        // no queue holds more blocks than there are buffers, so a push never waits
+        for (auto& q : _queues)
+          q = std::make_unique<bounded_queue<block_job>>(buffers);
+        }
+
+      std::vector<block_file_result> run(std::vector<block_stage_statistics>& statistics)
+        {
+        const char* names[] = { "read", "forward", _settings.smooth ? "smooth" : "threshold", "inverse", "write" };
+        const uint32_t threads[] = { _settings.reader_threads, _settings.forward_threads, _settings.threshold_threads, _settings.inverse_threads, _settings.writer_threads };
+        std::vector<thread_counters> counters[5];
+        std::atomic<uint32_t> active[5];
+        _start = clock_type::now();
+        std::vector<std::thread> workers;
+        for (int stage = 0; stage < 5; ++stage)
+          {
+          counters[stage].resize(std::max<uint32_t>(1, threads[stage]));
+          active[stage] = (uint32_t)counters[stage].size();
+          for (auto& c : counters[stage])
+            {
+            workers.emplace_back([this, stage, &c, &active]()
+              {
+              _guarded([&]() { _run_stage(stage, c); });
+              c.finished_seconds = seconds_since(_start);
+              // the last thread of a stage tells the next stage that no more blocks follow
+              if (--active[stage] == 0 && stage < 4)
+                _queues[stage]->close();
+              });
+            }
+          }
+        for (auto& w : workers)
+          w.join();
+
+        statistics.clear();
+        for (int stage = 0; stage < 5; ++stage)
+          {
+          block_stage_statistics s;
+          s.name = names[stage];
+          s.threads = (uint32_t)counters[stage].size();
+          for (const auto& c : counters[stage])
+            {
+            s.blocks += c.blocks;
+            s.bytes += c.bytes;
+            s.busy_seconds += c.busy_seconds;
+            s.wall_seconds = std::max(s.wall_seconds, c.finished_seconds);
+            }
+          statistics.push_back(s);
+          }
+        for (size_t f = 0; f < _files.size(); ++f)
+          {
+          _results[f].compressed = _files[f].compressed;
+          _files[f].output.close();
+          if (!_results[f].error.empty() || _aborted)
+            {
+            std::error_code ec;
+            std::filesystem::remove(_outputs[f], ec);
+            }
+          }
+        if (_error)
+          std::rethrow_exception(_error);
+        return _results;
+        }
+
+    private:
+      // an unexpected error stops the reader, the other stages drain their queues
+      template <class TFunc>
+      void _guarded(TFunc f)
+        {
+        try
+          {
+          f();
+          }
+        catch (...)
+          {
+          std::lock_guard<std::mutex> lock(_error_mutex);
+          if (!_error)
+            _error = std::current_exception();
+          _aborted = true;
+          }
+        }
+
+      void _run_stage(int stage, thread_counters& c)
+        {
+        if (stage == 0)
+          {
+          _read(c);
+          return;
+          }
+        bounded_queue<block_job>& in = *_queues[stage - 1];
+        block_job job;
+        while (in.pop(job))
+          {
+          if (_aborted)
+            {
+            _free->push(job.buffer);
+            continue;
+            }
+          const clock_type::time_point t0 = clock_type::now();
+          switch (stage)
+            {
+            case 1: _forward(job); break;
+            case 2: _threshold(job); break;
+            case 3: _inverse(job); break;
+            case 4: _write(job); break;
+            }
+          c.busy_seconds += seconds_since(t0);
+          ++c.blocks;
+          c.bytes += job.samples * sizeof(double);
+          if (stage < 4)
+            _queues[stage]->push(job);
+          }
+        }
+
+      bool _acquire_buffer(uint32_t& buffer)
+        {
+        uint32_t attempts = 0;
+        while (!_free->try_pop(buffer))
+          {
+          if (_aborted)
+            return false;
+          wait_backoff(attempts);
+          }
+        return true;
+        }
+
+      // the readers take whole files, so a file is read sequentially by one thread
+      void _read(thread_counters& c)
+        {
+        for (size_t f = _next_file++; f < _inputs.size() && !_aborted; f = _next_file++)
+          {
+          try
+            {
+            std::ifstream in(_inputs[f], std::ios::binary);
+            if (!in)
+              throw std::runtime_error("cannot open " + _inputs[f]);
+            const uint64_t bytes = std::filesystem::file_size(_inputs[f]);
+            if (bytes % sizeof(double) != 0)
+              throw std::runtime_error(_inputs[f] + " is not a file of doubles");
+            const uint64_t n = bytes / sizeof(double);
+            const uint64_t blocks = (n + _block_size - 1) / _block_size;
+            _results[f].samples = n;
+            _files[f].compressed = 0;
+            _files[f].blocks_left = blocks;
+            _files[f].output.open(_outputs[f], mapped_file::CREATE, bytes);
+            if (blocks == 0)
+              _files[f].output.close();
+            for (uint64_t b = 0; b < blocks; ++b)
+              {
+              block_job job;
+              if (!_acquire_buffer(job.buffer))
+                return;
+              const clock_type::time_point t0 = clock_type::now();
+              job.file = (uint32_t)f;
+              job.block = b;
+              job.samples = std::min<uint64_t>(_block_size, n - b * _block_size);
+              std::vector<double>& buffer = _buffers[job.buffer];
+              if (!in.read((char*)buffer.data(), (std::streamsize)(job.samples * sizeof(double))))
+                {
+                _free->push(job.buffer);
+                throw std::runtime_error("error reading " + _inputs[f]);
+                }
+              std::fill(buffer.begin() + job.samples, buffer.end(), buffer[job.samples - 1]);
+              c.busy_seconds += seconds_since(t0);
+              ++c.blocks;
+              c.bytes += job.samples * sizeof(double);
+              _queues[0]->push(job);
+              }
+            }
+          catch (std::runtime_error& e)
+            {
+            _results[f].error = e.what();
+            }
+          }
+        }
+
+      void _forward(const block_job& job)
+        {
+        double* sample = _buffers[job.buffer].data();
+        for (uint32_t lev = 0; lev < _settings.levels; ++lev)
+          forward(sample, _block_size, lev, _settings.s, _settings.custom_steps);
+        }
+
+      // only the details of valid samples are changed and counted, the extension is thrown away anyway
+      void _threshold(const block_job& job)
+        {
+        double* sample = _buffers[job.buffer].data();
+        if (_settings.smooth)
+          lifting::smooth(sample, job.samples, _settings.threshold, _settings.levels);
+        else
+          _files[job.file].compressed += lifting::compress(sample, job.samples, _settings.threshold, _settings.levels);
+        }
+
+      void _inverse(const block_job& job)
+        {
+        double* sample = _buffers[job.buffer].data();
+        for (uint32_t lev = _settings.levels; lev > 0; --lev)
+          inverse(sample, _block_size, lev - 1, _settings.s, _settings.custom_steps);
+        }
+
+      void _write(const block_job& job)
+        {
+        output_file& f = _files[job.file];
+        memcpy(f.output.data() + job.block * _block_size * sizeof(double), _buffers[job.buffer].data(), job.samples * sizeof(double));
+        _free->push(job.buffer);
+        if (--f.blocks_left == 0)
+          f.output.close();
+        }
+
+    private:
+      const std::vector<std::string>& _inputs;
+      const std::vector<std::string>& _outputs;
+      const block_pipeline_settings& _settings;
+      const uint64_t _block_size;
+      std::vector<std::vector<double>> _buffers;
+      std::unique_ptr<bounded_queue<uint32_t>> _free;
+      std::unique_ptr<bounded_queue<block_job>> _queues[4]; // behind read, forward, threshold and inverse
+      std::vector<output_file> _files;
+      std::vector<block_file_result> _results;
+      std::atomic<size_t> _next_file;
+      std::atomic<bool> _aborted;
+      std::mutex _error_mutex;
+      std::exception_ptr _error;
+      clock_type::time_point _start;
+    };
+  }
+
+std::vector<block_file_result> run_block_pipeline(const std::vector<std::string>& inputs, const std::vector<std::string>& outputs, const block_pipeline_settings& settings, std::vector<block_stage_statistics>& statistics)
+  {
+  if (inputs.size() != outputs.size())
+    throw std::runtime_error("every input needs an output");
+  if (settings.block_levels > 30)
+    throw std::runtime_error("the blocks are too large");
+  if (settings.levels > settings.block_levels)
+    throw std::runtime_error("the blocks have fewer levels than the transform");
+  block_executor executor(inputs, outputs, settings);
+  return executor.run(statistics);
+  }
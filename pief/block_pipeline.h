@@ -0,0 +1,60 @@
+#pragma once
+
+#include "model.h"
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/*
+Compression or smoothing of many raw signal files (native doubles) as a staged pipeline:
+
+  read -> forward -> threshold -> inverse -> write
+
+The signals are cut in blocks of 2^block_levels samples that are transformed independently, as a block codec does,
+so a signal of one block gets exactly the result of compress or smooth in model.h and longer signals differ from it
+near the block borders. The last block of a file is extended with its last sample.
+
+Each stage has its own threads, and the stages are connected by lock-free bounded queues (bounded_queue.h), so the
+reading and writing of one block overlaps with the transforms of others. Blocks live in a fixed pool of buffers that
+the reader takes and the writer gives back, which bounds the memory and makes the reader wait when the compute
+stages fall behind. Outputs are memory mapped and every block is copied to its place, so the writer threads need
+not keep the order of the blocks.
+*/
+
+struct block_pipeline_settings
+  {
+  bool smooth = false; // soft thresholding of smooth, instead of the hard thresholding of compress
+  uint32_t block_levels = 16;
+  uint32_t levels = 16; // of the transform, at most block_levels, the smooth level when smoothing
+  scheme s = jamlet_linear;
+  std::vector<lifting_step> custom_steps;
+  double threshold = 0.01;
+  uint32_t reader_threads = 1;
+  uint32_t forward_threads = 1;
+  uint32_t threshold_threads = 1;
+  uint32_t inverse_threads = 1;
+  uint32_t writer_threads = 1;
+  uint32_t buffers = 0; // two per thread when 0
+  };
+
+struct block_stage_statistics
+  {
+  std::string name;
+  uint32_t threads = 0;
+  uint64_t blocks = 0;
+  uint64_t bytes = 0; // of valid samples
+  double busy_seconds = 0.0; // of all threads together, without the waiting on queues
+  double wall_seconds = 0.0; // from the start of the pipeline until the last thread of the stage finished
+  };
+
+struct block_file_result
+  {
+  std::string error; // empty when the output was written
+  uint64_t samples = 0;
+  uint64_t compressed = 0; // details set to zero by compress
+  };
+
+// outputs[i] is written from inputs[i], the output of a file that failed is removed
+// statistics gets one entry per stage, in the order of the pipeline
+std::vector<block_file_result> run_block_pipeline(const std::vector<std::string>& inputs, const std::vector<std::string>& outputs, const block_pipeline_settings& settings, std::vector<block_stage_statistics>& statistics);
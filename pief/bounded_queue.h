@@ -0,0 +1,136 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+/*
+A lock-free bounded queue for any number of producers and consumers (D. Vyukov's array of sequenced cells).
+
+Every cell has a sequence number that tells whose turn it is: a producer may fill cell i when its sequence is the
+position it claimed, a consumer may empty it when the sequence is one past that. Claiming a position is a single
+compare and swap on the head or the tail, so threads only contend on the counters and never block each other.
+
+try_push and try_pop never wait. push and pop wait with wait_backoff; pop returns false once the queue is closed
+and empty, so the consumers of a stage stop after the last producer closed the queue.
+*/
+
+// spins a little, then yields, then sleeps, so waiting threads leave the core to the ones with work
+inline void wait_backoff(uint32_t& attempts)
+  {
+  ++attempts;
+  if (attempts < 16)
+    return;
+  if (attempts < 64)
+    std::this_thread::yield();
+  else
+    std::this_thread::sleep_for(std::chrono::microseconds(50));
+  }
+
+template <class T>
+class bounded_queue
+  {
+  public:
+    // the capacity is rounded up to a power of two
+    explicit bounded_queue(uint64_t capacity) : _closed(false), _head(0), _tail(0)
+      {
+      uint64_t size = 2;
+      while (size < capacity)
+        size <<= 1;
+      _mask = size - 1;
+      _cells.reset(new cell[size]);
+      for (uint64_t i = 0; i < size; ++i)
+        _cells[i].sequence.store(i, std::memory_order_relaxed);
+      }
+
+    bounded_queue(const bounded_queue&) = delete;
+    bounded_queue& operator = (const bounded_queue&) = delete;
+
+    bool try_push(const T& value)
+      {
+      uint64_t pos = _tail.load(std::memory_order_relaxed);
+      for (;;)
+        {
+        cell& c = _cells[pos & _mask];
+        const uint64_t sequence = c.sequence.load(std::memory_order_acquire);
+        const int64_t difference = (int64_t)sequence - (int64_t)pos;
+        if (difference == 0)
+          {
+          if (_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+            {
+            c.value = value;
+            c.sequence.store(pos + 1, std::memory_order_release);
+            return true;
+            }
+          }
+        else if (difference < 0)
+          return false; // full
+        else
+          pos = _tail.load(std::memory_order_relaxed);
+        }
+      }
+
+    bool try_pop(T& value)
+      {
+      uint64_t pos = _head.load(std::memory_order_relaxed);
+      for (;;)
+        {
+        cell& c = _cells[pos & _mask];
+        const uint64_t sequence = c.sequence.load(std::memory_order_acquire);
+        const int64_t difference = (int64_t)sequence - (int64_t)(pos + 1);
+        if (difference == 0)
+          {
+          if (_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+            {
+            value = c.value;
+            c.sequence.store(pos + _mask + 1, std::memory_order_release);
+            return true;
+            }
+          }
+        else if (difference < 0)
+          return false; // empty
+        else
+          pos = _head.load(std::memory_order_relaxed);
+        }
+      }
+
+    void push(const T& value)
+      {
+      uint32_t attempts = 0;
+      while (!try_push(value))
+        wait_backoff(attempts);
+      }
+
+    // false when the queue is closed and empty
+    bool pop(T& value)
+      {
+      uint32_t attempts = 0;
+      for (;;)
+        {
+        if (try_pop(value))
+          return true;
+        // an item pushed before close is seen by the try_pop after seeing the close
+        if (_closed.load(std::memory_order_acquire))
+          return try_pop(value);
+        wait_backoff(attempts);
+        }
+      }
+
+    // no more pushes follow
+    void close() { _closed.store(true, std::memory_order_release); }
+
+  private:
+    struct cell
+      {
+      std::atomic<uint64_t> sequence;
+      T value;
+      };
+
+    std::unique_ptr<cell[]> _cells;
+    uint64_t _mask;
+    std::atomic<bool> _closed;
+    alignas(64) std::atomic<uint64_t> _head;
+    alignas(64) std::atomic<uint64_t> _tail;
+  };
@@ -0,0 +1,416 @@
+#include "chunked_file.h"
+#include "parallel.h"
+
+#include "../lifting/lifting.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+
+namespace
+  {
+  const char header_magic[8] = { 'P', 'I', 'E', 'F', 'C', 'H', 'N', 'K' };
+  const char trailer_magic[8] = { 'P', 'I', 'E', 'F', 'I', 'N', 'D', 'X' };
+  const uint32_t version = 1;
+  const uint64_t trailer_size = 2 * sizeof(uint64_t) + sizeof(trailer_magic);
+  const uint64_t chunks_per_batch = 64;
+
+  template <class T>
+  void write_value(std::vector<char>& buffer, T value)
+    {
+    const char* p = reinterpret_cast<const char*>(&value);
+    buffer.insert(buffer.end(), p, p + sizeof(T));
+    }
+
+  template <class T>
+  T read_value(const char*& p, const char* end)
+    {
+    if (p + sizeof(T) > end)
+      throw std::runtime_error("chunked file is corrupt");
+    T value;
+    memcpy(&value, p, sizeof(T));
+    p += sizeof(T);
+    return value;
+    }
+
+  void write_varint(std::vector<char>& buffer, uint64_t value)
+    {
+    while (value >= 0x80)
+      {
+      buffer.push_back((char)((value & 0x7f) | 0x80));
+      value >>= 7;
+      }
+    buffer.push_back((char)value);
+    }
+
+  uint64_t read_varint(const char*& p, const char* end)
+    {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+      {
+      if (p == end)
+        break;
+      const uint8_t byte = (uint8_t)*p++;
+      value |= (uint64_t)(byte & 0x7f) << shift;
+      if ((byte & 0x80) == 0)
+        return value;
+      }
+    throw std::runtime_error("chunked file is corrupt");
+    }
+
+  uint64_t max_mask_size(const chunked_file_header& h)
+    {
+    uint64_t sz = 1;
+    for (const auto& step : get_lifting_steps(h.s, h.custom_steps))
+      sz = std::max<uint64_t>(sz, step.mask.size());
+    return sz;
+    }
+
+  void validate(const chunked_file_header& h)
+    {
+    if (h.chunk_levels > 40 || h.levels > h.chunk_levels)
+      throw std::runtime_error("invalid number of chunk levels");
+    if (h.s == custom && h.custom_steps.empty())
+      throw std::runtime_error("custom scheme without lifting steps");
+    // the cyclical kernels wrap around at most once, so the coarsest level needs at least as many samples as the widest mask
+    if ((((uint64_t)1 << h.chunk_levels) >> h.levels) < max_mask_size(h))
+      throw std::runtime_error("too many lifting levels for the chunk size");
+    }
+
+  std::vector<char> encode_header(const chunked_file_header& h)
+    {
+    std::vector<char> buffer(header_magic, header_magic + sizeof(header_magic));
+    write_value<uint32_t>(buffer, version);
+    write_value<int32_t>(buffer, (int32_t)h.s);
+    write_value<uint32_t>(buffer, h.chunk_levels);
+    write_value<uint32_t>(buffer, h.levels);
+    write_value<double>(buffer, h.threshold);
+    write_value<uint32_t>(buffer, (uint32_t)h.custom_steps.size());
+    for (const auto& step : h.custom_steps)
+      {
+      write_value<int32_t>(buffer, (int32_t)step.type);
+      write_value<int32_t>(buffer, (int32_t)step.only_scale_away_from_border);
+      write_value<uint32_t>(buffer, (uint32_t)step.mask.size());
+      for (double v : step.mask)
+        write_value<double>(buffer, v);
+      }
+    return buffer;
+    }
+
+  // data_start gets the end of the header
+  chunked_file_header read_header(std::istream& f, uint64_t& data_start)
+    {
+    char magic[sizeof(header_magic)];
+    uint32_t fixed[2];
+    f.seekg(0);
+    f.read(magic, sizeof(magic));
+    f.read(reinterpret_cast<char*>(fixed), sizeof(fixed));
+    if (!f || memcmp(magic, header_magic, sizeof(magic)) != 0)
+      throw std::runtime_error("not a chunked signal file");
+    if (fixed[0] != version)
+      throw std::runtime_error("unsupported chunked file version");
+    chunked_file_header h;
+    h.s = (scheme)fixed[1];
+    f.read(reinterpret_cast<char*>(&h.chunk_levels), sizeof(uint32_t));
+    f.read(reinterpret_cast<char*>(&h.levels), sizeof(uint32_t));
+    f.read(reinterpret_cast<char*>(&h.threshold), sizeof(double));
+    uint32_t nr_of_steps = 0;
+    f.read(reinterpret_cast<char*>(&nr_of_steps), sizeof(uint32_t));
+    if (!f || (int)h.s < 0 || h.s > custom)
+      throw std::runtime_error("chunked file header is corrupt");
+    for (uint32_t i = 0; i < nr_of_steps && f; ++i)
+      {
+      int32_t type = 0;
+      int32_t only_scale_away_from_border = 1;
+      uint32_t mask_size = 0;
+      f.read(reinterpret_cast<char*>(&type), sizeof(int32_t));
+      f.read(reinterpret_cast<char*>(&only_scale_away_from_border), sizeof(int32_t));
+      f.read(reinterpret_cast<char*>(&mask_size), sizeof(uint32_t));
+      if (type < (int32_t)lst_predict || type > (int32_t)lst_scale_odd || mask_size > 4096)
+        throw std::runtime_error("chunked file header is corrupt");
+      h.custom_steps.emplace_back();
+      h.custom_steps.back().type = (lifting_step_type)type;
+      h.custom_steps.back().only_scale_away_from_border = only_scale_away_from_border;
+      h.custom_steps.back().mask.resize(mask_size);
+      f.read(reinterpret_cast<char*>(h.custom_steps.back().mask.data()), sizeof(double)*mask_size);
+      }
+    if (!f)
+      throw std::runtime_error("chunked file header is corrupt");
+    validate(h);
+    data_start = (uint64_t)f.tellg();
+    return h;
+    }
+
+  // every chunk must lie between the header and the index, in the order of the signal
+  std::vector<chunk_entry> read_index(std::istream& f, uint64_t file_size, uint64_t data_start, uint32_t chunk_levels, uint64_t& index_offset)
+    {
+    if (file_size < trailer_size)
+      throw std::runtime_error("chunked file has no index");
+    uint64_t nr_of_chunks = 0;
+    char magic[sizeof(trailer_magic)];
+    f.seekg(file_size - trailer_size);
+    f.read(reinterpret_cast<char*>(&nr_of_chunks), sizeof(uint64_t));
+    f.read(reinterpret_cast<char*>(&index_offset), sizeof(uint64_t));
+    f.read(magic, sizeof(magic));
+    if (!f || memcmp(magic, trailer_magic, sizeof(magic)) != 0)
+      throw std::runtime_error("chunked file has no index");
+    if (index_offset < data_start || index_offset > file_size - trailer_size || nr_of_chunks != (file_size - trailer_size - index_offset) / sizeof(chunk_entry)
+      || index_offset + nr_of_chunks * sizeof(chunk_entry) + trailer_size != file_size)
+      throw std::runtime_error("chunked file index is corrupt");
+    std::vector<chunk_entry> index((size_t)nr_of_chunks);
+    f.seekg(index_offset);
+    f.read(reinterpret_cast<char*>(index.data()), sizeof(chunk_entry)*nr_of_chunks);
+    if (!f)
+      throw std::runtime_error("chunked file index is corrupt");
+    const uint64_t sz = (uint64_t)1 << chunk_levels;
+    uint64_t previous_end = data_start;
+    for (size_t i = 0; i < index.size(); ++i)
+      {
+      const chunk_entry& entry = index[i];
+      const bool last = i + 1 == index.size();
+      if (entry.offset < previous_end || entry.size > index_offset - entry.offset || entry.samples == 0 || entry.samples > sz || (!last && entry.samples != sz)
+        || (entry.samples < sz && entry.size != entry.samples * sizeof(double)))
+        throw std::runtime_error("chunked file index is corrupt");
+      previous_end = entry.offset + entry.size;
+      }
+    return index;
+    }
+
+  void encode_chunk(std::vector<char>& buffer, const double* samples, uint64_t nr_of_samples, const chunked_file_header& h)
+    {
+    const uint64_t n = (uint64_t)1 << h.chunk_levels;
+    std::vector<double> chunk((size_t)n, nr_of_samples ? samples[nr_of_samples - 1] : 0.0);
+    std::copy(samples, samples + nr_of_samples, chunk.begin());
+    for (uint32_t lev = 0; lev < h.levels; ++lev)
+      forward(chunk.data(), n, lev, h.s, h.custom_steps, 1, true);
+    lifting::compress(chunk.data(), n, h.threshold, h.levels);
+    const uint64_t nonzeros = (uint64_t)std::count_if(chunk.begin(), chunk.end(), [](double v) { return v != 0.0; });
+    buffer.clear();
+    buffer.reserve((size_t)(sizeof(uint64_t) + nonzeros * (sizeof(double) + 2)));
+    write_value<uint64_t>(buffer, nonzeros);
+    uint64_t previous = 0;
+    for (uint64_t i = 0; i < n; ++i)
+      {
+      if (chunk[i] != 0.0)
+        {
+        write_varint(buffer, i - previous);
+        write_value<double>(buffer, chunk[i]);
+        previous = i;
+        }
+      }
+    }
+
+  void decode_chunk(std::vector<double>& chunk, const char* p, const char* end, const chunked_file_header& h)
+    {
+    const uint64_t n = (uint64_t)1 << h.chunk_levels;
+    chunk.assign((size_t)n, 0.0);
+    const uint64_t nonzeros = read_value<uint64_t>(p, end);
+    uint64_t i = 0;
+    for (uint64_t k = 0; k < nonzeros; ++k)
+      {
+      i += read_varint(p, end);
+      if (i >= n)
+        throw std::runtime_error("chunked file is corrupt");
+      chunk[i] = read_value<double>(p, end);
+      }
+    for (int lev = (int)h.levels - 1; lev >= 0; --lev)
+      inverse(chunk.data(), n, lev, h.s, h.custom_steps, 1, true);
+    }
+  }
+
+chunked_writer::chunked_writer(const std::string& filename, scheme s, const std::vector<lifting_step>& custom_steps, uint32_t chunk_levels, uint32_t levels, double threshold) : _filename(filename)
+  {
+  _header.s = s;
+  if (s == custom)
+    _header.custom_steps = custom_steps;
+  _header.chunk_levels = chunk_levels;
+  _header.levels = levels;
+  _header.threshold = threshold;
+  validate(_header);
+  _f.open(filename, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!_f.is_open())
+    throw std::runtime_error("cannot create " + filename);
+  auto h = encode_header(_header);
+  _f.write(h.data(), h.size());
+  _data_end = h.size();
+  flush();
+  }
+
+chunked_writer::chunked_writer(const std::string& filename) : _filename(filename)
+  {
+  _f.open(filename, std::ios::in | std::ios::out | std::ios::binary);
+  if (!_f.is_open())
+    throw std::runtime_error("cannot open " + filename);
+  uint64_t data_start = 0;
+  _header = read_header(_f, data_start);
+  uint64_t index_offset = 0;
+  _index = read_index(_f, (uint64_t)std::filesystem::file_size(filename), data_start, _header.chunk_levels, index_offset);
+  _data_end = index_offset;
+  // a partial last chunk holds its samples as they were appended, so it is completed without loss
+  if (!_index.empty() && _index.back().samples < ((uint64_t)1 << _header.chunk_levels))
+    {
+    const chunk_entry last = _index.back();
+    _tail.resize((size_t)last.samples);
+    _f.seekg(last.offset);
+    _f.read(reinterpret_cast<char*>(_tail.data()), sizeof(double)*_tail.size());
+    if (!_f)
+      throw std::runtime_error("chunked file is corrupt");
+    _index.pop_back();
+    _data_end = last.offset;
+    }
+  }
+
+chunked_writer::~chunked_writer()
+  {
+  try
+    {
+    close();
+    }
+  catch (...)
+    {
+    }
+  }
+
+uint64_t chunked_writer::size() const
+  {
+  uint64_t sz = _tail.size();
+  for (const auto& entry : _index)
+    sz += entry.samples;
+  return sz;
+  }
+
+void chunked_writer::_write_chunks(const double* samples, uint64_t nr_of_chunks)
+  {
+  const uint64_t n = (uint64_t)1 << _header.chunk_levels;
+  std::vector<std::vector<char>> encoded((size_t)std::min<uint64_t>(nr_of_chunks, chunks_per_batch));
+  for (uint64_t batch = 0; batch < nr_of_chunks; batch += chunks_per_batch)
+    {
+    const uint64_t batch_size = std::min<uint64_t>(chunks_per_batch, nr_of_chunks - batch);
+    parallel_for(0, batch_size, [&](uint64_t i)
+      {
+      encode_chunk(encoded[i], samples + (batch + i)*n, n, _header);
+      });
+    _f.seekp(_data_end);
+    for (uint64_t i = 0; i < batch_size; ++i)
+      {
+      _f.write(encoded[i].data(), encoded[i].size());
+      _index.push_back({ _data_end, (uint64_t)encoded[i].size(), n });
+      _data_end += encoded[i].size();
+      }
+    }
+  if (!_f)
+    throw std::runtime_error("error writing chunked file");
+  }
+
+void chunked_writer::append(const double* samples, uint64_t n)
+  {
+  if (!_f.is_open())
+    throw std::runtime_error("chunked file is closed");
+  const uint64_t sz = (uint64_t)1 << _header.chunk_levels;
+  if (!_tail.empty())
+    {
+    const uint64_t missing = std::min<uint64_t>(sz - _tail.size(), n);
+    _tail.insert(_tail.end(), samples, samples + missing);
+    samples += missing;
+    n -= missing;
+    if (_tail.size() < sz)
+      return;
+    _write_chunks(_tail.data(), 1);
+    _tail.clear();
+    }
+  const uint64_t full_chunks = n / sz;
+  _write_chunks(samples, full_chunks);
+  _tail.assign(samples + full_chunks * sz, samples + n);
+  }
+
+void chunked_writer::flush()
+  {
+  if (!_f.is_open())
+    return;
+  std::vector<chunk_entry> index = _index;
+  uint64_t end = _data_end;
+  _f.seekp(_data_end);
+  if (!_tail.empty())
+    {
+    const uint64_t bytes = sizeof(double)*_tail.size();
+    _f.write(reinterpret_cast<const char*>(_tail.data()), bytes);
+    index.push_back({ end, bytes, (uint64_t)_tail.size() });
+    end += bytes;
+    }
+  const uint64_t nr_of_chunks = index.size();
+  _f.write(reinterpret_cast<const char*>(index.data()), sizeof(chunk_entry)*index.size());
+  _f.write(reinterpret_cast<const char*>(&nr_of_chunks), sizeof(uint64_t));
+  _f.write(reinterpret_cast<const char*>(&end), sizeof(uint64_t));
+  _f.write(trailer_magic, sizeof(trailer_magic));
+  _f.flush();
+  if (!_f)
+    throw std::runtime_error("error writing chunked file");
+  // an earlier flush can have left a longer tail behind the new trailer
+  const uint64_t file_size = end + sizeof(chunk_entry)*nr_of_chunks + trailer_size;
+  if ((uint64_t)std::filesystem::file_size(_filename) > file_size)
+    std::filesystem::resize_file(_filename, file_size);
+  }
+
+void chunked_writer::close()
+  {
+  if (!_f.is_open())
+    return;
+  flush();
+  _f.close();
+  }
+
+chunked_reader::chunked_reader(const std::string& filename) : _size(0)
+  {
+  _f.open(filename, std::ios::in | std::ios::binary);
+  if (!_f.is_open())
+    throw std::runtime_error("cannot open " + filename);
+  uint64_t data_start = 0;
+  _header = read_header(_f, data_start);
+  uint64_t index_offset = 0;
+  _index = read_index(_f, (uint64_t)std::filesystem::file_size(filename), data_start, _header.chunk_levels, index_offset);
+  for (const auto& entry : _index)
+    _size += entry.samples;
+  }
+
+void chunked_reader::read(double* values, uint64_t first, uint64_t last)
+  {
+  if (last > _size || first > last)
+    throw std::runtime_error("range exceeds the chunked signal");
+  if (first == last)
+    return;
+  const uint64_t sz = chunk_size();
+  const uint64_t first_chunk = first / sz;
+  const uint64_t last_chunk = (last - 1) / sz;
+  const uint64_t begin = _index[first_chunk].offset;
+  const uint64_t end = _index[last_chunk].offset + _index[last_chunk].size;
+  std::vector<char> bytes((size_t)(end - begin));
+  _f.clear();
+  _f.seekg(begin);
+  _f.read(bytes.data(), bytes.size());
+  if (!_f)
+    throw std::runtime_error("error reading chunked file");
+  parallel_for(first_chunk, last_chunk + 1, [&](uint64_t c)
+    {
+    const chunk_entry& entry = _index[c];
+    const char* p = bytes.data() + (entry.offset - begin);
+    const uint64_t chunk_first = std::max<uint64_t>(first, c * sz);
+    const uint64_t chunk_last = std::min<uint64_t>(last, c * sz + entry.samples);
+    if (entry.samples < sz)
+      {
+      // the partial last chunk is stored raw
+      memcpy(values + (chunk_first - first), p + (chunk_first - c * sz) * sizeof(double), (chunk_last - chunk_first) * sizeof(double));
+      return;
+      }
+    std::vector<double> chunk;
+    decode_chunk(chunk, p, p + entry.size, _header);
+    std::copy(chunk.begin() + (chunk_first - c * sz), chunk.begin() + (chunk_last - c * sz), values + (chunk_first - first));
+    });
+  }
+
+std::vector<double> chunked_reader::read(uint64_t first, uint64_t last)
+  {
+  std::vector<double> values((size_t)(last > first ? last - first : 0));
+  read(values.data(), first, last);
+  return values;
+  }
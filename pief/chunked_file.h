@@ -0,0 +1,92 @@
+#pragma once
+
+#include "model.h"
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/*
+Seekable container for compressed signals.
+
+The signal is cut in chunks of 2^chunk_levels samples. Every chunk is transformed on its own with
+'levels' cyclical lifting steps, so that no chunk depends on its neighbours, thresholded with
+lifting::compress, and stored as the sparse list of its nonzero coefficients. A partial last chunk
+is stored as raw samples, so that reopening the file and appending completes it without compressing
+it twice. An index with the position of each chunk is kept in the footer, so a
+reader only decodes the chunks that overlap the requested range.
+
+Layout (native byte order, little endian on all supported platforms):
+  header  : "PIEFCHNK", uint32 version, int32 scheme, uint32 chunk_levels, uint32 levels, double threshold,
+            uint32 number of custom steps, per step: int32 type, int32 only_scale_away_from_border, uint32 mask size, mask values
+  chunk   : uint64 number of nonzero coefficients, per coefficient: varint index delta, double value
+            (a partial last chunk: its samples as doubles)
+  index   : per chunk: uint64 offset, uint64 size in bytes, uint64 number of samples
+  trailer : uint64 number of chunks, uint64 offset of the index, "PIEFINDX"
+*/
+
+struct chunked_file_header
+  {
+  scheme s;
+  std::vector<lifting_step> custom_steps;
+  uint32_t chunk_levels;
+  uint32_t levels;
+  double threshold;
+  };
+
+struct chunk_entry
+  {
+  uint64_t offset;
+  uint64_t size;
+  uint64_t samples;
+  };
+
+class chunked_writer
+  {
+  public:
+    // creates a new file
+    chunked_writer(const std::string& filename, scheme s, const std::vector<lifting_step>& custom_steps, uint32_t chunk_levels, uint32_t levels, double threshold);
+    // opens an existing file for appending
+    chunked_writer(const std::string& filename);
+    ~chunked_writer();
+
+    void append(const double* samples, uint64_t n);
+
+    // writes the pending samples and the index, after which the file can be read
+    void flush();
+    void close();
+
+    uint64_t size() const;
+
+  private:
+    void _write_chunks(const double* samples, uint64_t nr_of_chunks);
+
+  private:
+    std::string _filename;
+    std::fstream _f;
+    chunked_file_header _header;
+    std::vector<chunk_entry> _index;
+    std::vector<double> _tail;
+    uint64_t _data_end;
+  };
+
+class chunked_reader
+  {
+  public:
+    chunked_reader(const std::string& filename);
+
+    const chunked_file_header& header() const { return _header; }
+    uint64_t size() const { return _size; }
+    uint64_t chunk_size() const { return (uint64_t)1 << _header.chunk_levels; }
+
+    // decodes the samples in [first, last), the chunks involved are decoded in parallel
+    void read(double* values, uint64_t first, uint64_t last);
+    std::vector<double> read(uint64_t first, uint64_t last);
+
+  private:
+    std::ifstream _f;
+    chunked_file_header _header;
+    std::vector<chunk_entry> _index;
+    uint64_t _size;
+  };
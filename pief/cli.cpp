@@ -0,0 +1,470 @@
+/*
+pief-cli: the transforms of pief without a window, for batch jobs on machines without a display.
+
+Signals are raw files of native doubles, as for out_of_core_forward. Every operation streams through a coefficient
+pyramid on disk (see out_of_core.h and pyramid_file.h), so a signal never has to fit in memory. The input files are
+processed in parallel, one file per job.
+With --block-levels, compress and smooth run as a staged pipeline over blocks of the signals instead (see
+block_pipeline.h), which overlaps reading and writing with the transforms.
+lift and unlift take raw, WAV, .npy and text files with any number of channels (see signal_file.h and
+text_signal.h) and transform every channel in place in the memory mapped output. import turns text files into
+signals for the other commands.
+*/
+
+#include "batch_analysis.h"
+#include "block_pipeline.h"
+#include "logging.h"
+#include "model.h"
+#include "out_of_core.h"
+#include "pyramid_file.h"
+#include "signal_file.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+  {
+  const char* commands[] = { "forward", "inverse", "compress", "smooth", "spline", "wavelet", "lift", "unlift", "import", "analyze", "help", "--help" };
+
+  struct options
+    {
+    std::string command;
+    std::vector<std::string> inputs;
+    scheme s = jamlet_linear;
+    std::vector<lifting_step> custom_steps;
+    int levels = -1; // the largest number up to max_default_levels that the signal allows
+    double threshold = 0.01;
+    uint32_t smooth_level = 2;
+    std::string output_folder; // next to the input when empty
+    uint64_t memory_budget = default_memory_budget;
+    uint32_t jobs = 0; // one per core
+    text_signal_options text_options;
+    int block_levels = -1; // compress and smooth the whole signal when negative
+    uint32_t stage_threads[5] = { 1, 1, 1, 1, 1 }; // read, forward, threshold, inverse, write
+    };
+
+  void print_usage()
+    {
+    std::cout << "usage: pief-cli <command> [options] <files>\n\n";
+    std::cout << "commands:\n";
+    std::cout << "  forward    raw signal to coefficient pyramid (.pyr)\n";
+    std::cout << "  inverse    coefficient pyramid to raw signal (.inverse.raw)\n";
+    std::cout << "  compress   sets the details below the threshold to zero (.compressed.raw)\n";
+    std::cout << "  smooth     soft thresholds the details of the smooth level finest levels (.smooth.raw)\n";
+    std::cout << "  spline     the component in the spline space after 'levels' levels (.spline.raw)\n";
+    std::cout << "  wavelet    the component in the coarsest wavelet space of 'levels' levels (.wavelet.raw)\n";
+    std::cout << "  lift       every channel of a raw, .wav or .npy signal to its coefficients (.lifted)\n";
+    std::cout << "  unlift     the inverse of lift (.unlifted)\n";
+    std::cout << "  import     a CSV, tab or white space separated text file to a raw signal, or .npy with more than one column\n";
+    std::cout << "  analyze    scripts or folders of scripts to JSON lines on stdout\n\n";
+    std::cout << "options:\n";
+    std::cout << "  --scheme <name>        jamlet_linear (default), jamlet_quadratic, jamlet_cubic, jamlet_4_point, cdf_5_3, cdf_9_7,\n";
+    std::cout << "                         chaikin, cubic_bsplines, cubic_bspline_wavelets, daubechies_d4, four_point, haar\n";
+    std::cout << "  --script <file>        a custom scheme\n";
+    std::cout << "  --levels <n>           number of levels, by default the most the signal allows up to " << max_default_levels << "\n";
+    std::cout << "  --threshold <t>        of compress and smooth, default 0.01\n";
+    std::cout << "  --smooth-level <n>     default 2\n";
+    std::cout << "  --output <folder>      by default the results are written next to the inputs\n";
+    std::cout << "  --memory <MB>          memory budget of all jobs together, default " << default_memory_budget / (1024 * 1024) << "\n";
+    std::cout << "  --jobs <n>             files processed at once, default one per core\n";
+    std::cout << "  --columns <a,b,...>    the columns of text files, zero based, by default all of them\n";
+    std::cout << "  --missing <value>      of empty or invalid fields of text files, default nan\n";
+    std::cout << "  --delimiter <d>        of text files: , ; tab or space (any white space), by default detected\n";
+    std::cout << "  --block-levels <n>     compress and smooth blocks of 2^n samples in a staged pipeline\n";
+    std::cout << "  --stage-threads <r,f,t,i,w>  threads of the read, forward, threshold, inverse and write stages, default 1 each\n";
+    }
+
+  std::string read_text_file(const std::string& filename)
+    {
+    std::ifstream t(filename);
+    if (!t)
+      throw std::runtime_error("cannot open " + filename);
+    return std::string((std::istreambuf_iterator<char>(t)), std::istreambuf_iterator<char>());
+    }
+
+  char parse_delimiter(const std::string& value)
+    {
+    if (value == "tab" || value == "\\t" || value == "\t")
+      return '\t';
+    if (value == "space" || value == " ")
+      return ' ';
+    if (value == "," || value == ";")
+      return value[0];
+    throw std::runtime_error("unknown delimiter " + value);
+    }
+
+  options parse_options(int argc, char** argv)
+    {
+    if (argc < 2)
+      throw std::runtime_error("no command");
+    options o;
+    o.command = argv[1];
+    if (std::find(std::begin(commands), std::end(commands), o.command) == std::end(commands))
+      throw std::runtime_error("unknown command " + o.command);
+    for (int i = 2; i < argc; ++i)
+      {
+      const std::string arg = argv[i];
+      if (arg.size() < 2 || arg.compare(0, 2, "--") != 0)
+        {
+        o.inputs.push_back(arg);
+        continue;
+        }
+      if (i + 1 >= argc)
+        throw std::runtime_error(arg + " needs a value");
+      const std::string value = argv[++i];
+      if (arg == "--scheme")
+        o.s = scheme_from_name(value);
+      else if (arg == "--script")
+        {
+        compile(o.custom_steps, read_text_file(value));
+        o.s = custom;
+        }
+      else if (arg == "--levels")
+        o.levels = std::stoi(value);
+      else if (arg == "--threshold")
+        o.threshold = std::stod(value);
+      else if (arg == "--smooth-level")
+        o.smooth_level = (uint32_t)std::stoul(value);
+      else if (arg == "--output")
+        o.output_folder = value;
+      else if (arg == "--memory")
+        o.memory_budget = (uint64_t)std::stoull(value) * 1024 * 1024;
+      else if (arg == "--jobs")
+        o.jobs = (uint32_t)std::stoul(value);
+      else if (arg == "--columns")
+        {
+        std::stringstream str(value);
+        std::string column;
+        while (std::getline(str, column, ','))
+          o.text_options.columns.push_back((uint32_t)std::stoul(column));
+        }
+      else if (arg == "--missing")
+        o.text_options.missing_value = std::stod(value);
+      else if (arg == "--delimiter")
+        o.text_options.delimiter = parse_delimiter(value);
+      else if (arg == "--block-levels")
+        o.block_levels = std::stoi(value);
+      else if (arg == "--stage-threads")
+        {
+        std::stringstream str(value);
+        std::string threads;
+        int stage = 0;
+        while (std::getline(str, threads, ','))
+          {
+          if (stage == 5)
+            throw std::runtime_error("--stage-threads has five stages");
+          o.stage_threads[stage++] = std::max<uint32_t>(1, (uint32_t)std::stoul(threads));
+          }
+        }
+      else
+        throw std::runtime_error("unknown option " + arg);
+      }
+    if (o.levels > 62)
+      throw std::runtime_error("too many levels");
+    return o;
+    }
+
+  std::string output_filename(const options& o, const std::string& input, const char* suffix)
+    {
+    std::filesystem::path p(input);
+    std::filesystem::path folder = o.output_folder.empty() ? p.parent_path() : std::filesystem::path(o.output_folder);
+    return (folder / (p.stem().string() + suffix)).string();
+    }
+
+  // the container of the input, a raw file of PCM samples becomes a raw file of doubles and a text file a .npy file
+  std::string signal_output_filename(const options& o, const std::string& input, const std::string& suffix)
+    {
+    std::string extension = std::filesystem::path(input).extension().string();
+    if (is_text_signal(input))
+      extension = ".npy";
+    else if (get_signal_container(input) == sc_raw && get_raw_sample_format(input) == sf_int16)
+      extension = ".raw";
+    return output_filename(o, input, (suffix + extension).c_str());
+    }
+
+  // n is the number of samples of the signal
+  uint32_t get_levels(const options& o, uint64_t n)
+    {
+    return o.levels >= 0 ? (uint32_t)o.levels : default_levels(n);
+    }
+
+  uint32_t get_levels(const options& o, const std::string& input)
+    {
+    return get_levels(o, std::filesystem::file_size(input) / sizeof(double));
+    }
+
+  // forward into a temporary pyramid, change its coefficients, and inverse into the output
+  // with zero levels the pyramid is the signal itself, so the output is the input unchanged
+  template <class TFunc>
+  void process_coefficients(const options& o, const std::string& input, const std::string& output, uint32_t levels, uint64_t memory_budget, TFunc f)
+    {
+    const std::string temporary = output + ".pyr.tmp";
+    try
+      {
+        {
+        out_of_core_forward(input, temporary, levels, o.s, o.custom_steps, memory_budget);
+        pyramid_file pyr(temporary, true);
+        f(pyr);
+        pyr.flush();
+        }
+      out_of_core_inverse(temporary, output, memory_budget);
+      if (std::filesystem::file_size(output) != std::filesystem::file_size(input))
+        throw std::runtime_error(output + " was not written completely");
+      }
+    catch (...)
+      {
+      std::error_code ec;
+      std::filesystem::remove(temporary, ec);
+      std::filesystem::remove(output, ec);
+      throw;
+      }
+    std::filesystem::remove(temporary);
+    }
+
+  // returns the line for the report
+  std::string process_file(const options& o, const std::string& input, uint64_t memory_budget)
+    {
+    if (o.command == "forward")
+      {
+      const std::string output = output_filename(o, input, ".pyr");
+      out_of_core_forward(input, output, get_levels(o, input), o.s, o.custom_steps, memory_budget);
+      return input + " -> " + output;
+      }
+    if (o.command == "inverse")
+      {
+      const std::string output = output_filename(o, input, ".inverse.raw");
+      out_of_core_inverse(input, output, memory_budget);
+      return input + " -> " + output;
+      }
+    if (o.command == "compress")
+      {
+      const std::string output = output_filename(o, input, ".compressed.raw");
+      uint64_t compressed = 0, n = 0;
+      process_coefficients(o, input, output, get_levels(o, input), memory_budget, [&](pyramid_file& pyr)
+        {
+        n = pyr.size();
+        for (uint32_t level = 0; level < pyr.levels(); ++level)
+          {
+          for (double& c : pyr.writable_details(level))
+            {
+            if (std::abs(c) < o.threshold)
+              {
+              c = 0.0;
+              ++compressed;
+              }
+            }
+          }
+        });
+      return input + " -> " + output + ", compression ratio " + std::to_string(n ? (double)compressed / (double)n : 0.0);
+      }
+    if (o.command == "smooth")
+      {
+      const std::string output = output_filename(o, input, ".smooth.raw");
+      process_coefficients(o, input, output, o.smooth_level, memory_budget, [&](pyramid_file& pyr)
+        {
+        for (uint32_t level = 0; level < pyr.levels(); ++level)
+          {
+          for (double& c : pyr.writable_details(level))
+            {
+            if (c > o.threshold)
+              c -= o.threshold;
+            else if (c < -o.threshold)
+              c += o.threshold;
+            else
+              c = 0.0;
+            }
+          }
+        });
+      return input + " -> " + output;
+      }
+    if (o.command == "lift" || o.command == "unlift")
+      {
+      const bool lift = o.command == "lift";
+      const std::string output = signal_output_filename(o, input, lift ? ".lifted" : ".unlifted");
+      const uint32_t levels = get_levels(o, get_signal_frames(input));
+      transform_signal_file(input, output, levels, o.s, o.custom_steps, !lift, o.text_options);
+      return input + " -> " + output;
+      }
+    if (o.command == "import")
+      {
+      const text_signal_file in(input, o.text_options);
+      signal_layout layout;
+      layout.container = in.channels() == 1 ? sc_raw : sc_npy;
+      layout.channels = in.channels();
+      layout.frames = in.frames();
+      const std::string output = output_filename(o, input, in.channels() == 1 ? ".raw" : ".npy");
+      signal_output out(output, layout);
+      const uint64_t missing = in.read(out.samples<double>(), out.stride());
+      out.flush();
+      return input + " -> " + output + ", " + std::to_string(in.frames()) + " frames of " + std::to_string(in.channels()) + " channels, " + std::to_string(missing) + " missing values";
+      }
+    if (o.command == "spline" || o.command == "wavelet")
+      {
+      const bool spline = o.command == "spline";
+      const std::string output = output_filename(o, input, spline ? ".spline.raw" : ".wavelet.raw");
+      const uint32_t levels = get_levels(o, input);
+      if (levels == 0)
+        throw std::runtime_error("the component needs at least one level");
+      process_coefficients(o, input, output, levels, memory_budget, [&](pyramid_file& pyr)
+        {
+        if (!spline)
+          {
+          const coefficient_span c = pyr.writable_coarse();
+          std::fill(c.begin(), c.end(), 0.0);
+          }
+        for (uint32_t level = 0; level < pyr.levels(); ++level)
+          {
+          if (spline || level + 1 != pyr.levels())
+            {
+            const coefficient_span d = pyr.writable_details(level);
+            std::fill(d.begin(), d.end(), 0.0);
+            }
+          }
+        });
+      return input + " -> " + output;
+      }
+    throw std::runtime_error("unknown command " + o.command);
+    }
+
+  int run_analyze(const options& o)
+    {
+    std::vector<batch_scheme> schemes;
+    for (const auto& input : o.inputs)
+      {
+      if (std::filesystem::is_directory(input))
+        {
+        const std::vector<batch_scheme> folder = read_scheme_folder(input);
+        schemes.insert(schemes.end(), folder.begin(), folder.end());
+        }
+      else
+        {
+        schemes.emplace_back();
+        schemes.back().name = std::filesystem::path(input).stem().string();
+        schemes.back().script = read_text_file(input);
+        }
+      }
+    for (const auto& record : analyze_batch(schemes))
+      std::cout << record << "\n";
+    return 0;
+    }
+
+  int run_blocks(const options& o)
+    {
+    const bool smooth = o.command == "smooth";
+    block_pipeline_settings settings;
+    settings.smooth = smooth;
+    settings.block_levels = (uint32_t)o.block_levels;
+    settings.levels = smooth ? o.smooth_level : (o.levels >= 0 ? (uint32_t)o.levels : std::min<uint32_t>(max_default_levels, settings.block_levels));
+    settings.s = o.s;
+    settings.custom_steps = o.custom_steps;
+    settings.threshold = o.threshold;
+    settings.reader_threads = o.stage_threads[0];
+    settings.forward_threads = o.stage_threads[1];
+    settings.threshold_threads = o.stage_threads[2];
+    settings.inverse_threads = o.stage_threads[3];
+    settings.writer_threads = o.stage_threads[4];
+    std::vector<std::string> outputs;
+    for (const auto& input : o.inputs)
+      outputs.push_back(output_filename(o, input, smooth ? ".smooth.raw" : ".compressed.raw"));
+    std::vector<block_stage_statistics> statistics;
+    const std::vector<block_file_result> results = run_block_pipeline(o.inputs, outputs, settings, statistics);
+    bool failed = false;
+    for (size_t i = 0; i < results.size(); ++i)
+      {
+      if (!results[i].error.empty())
+        {
+        failed = true;
+        std::cerr << o.inputs[i] << ": " << results[i].error << std::endl;
+        }
+      else if (smooth)
+        std::cout << o.inputs[i] << " -> " << outputs[i] << std::endl;
+      else
+        std::cout << o.inputs[i] << " -> " << outputs[i] << ", compression ratio " << (results[i].samples ? (double)results[i].compressed / (double)results[i].samples : 0.0) << std::endl;
+      }
+    for (const auto& s : statistics)
+      {
+      const double mb = (double)s.bytes / (1024.0 * 1024.0);
+      std::cerr << "stage " << s.name << ": " << s.threads << " threads, " << s.blocks << " blocks, " << mb / std::max(s.wall_seconds, 1e-9) << " MB/s, busy "
+        << 100.0 * s.busy_seconds / std::max(s.threads * s.wall_seconds, 1e-9) << "%" << std::endl;
+      }
+    return failed ? 1 : 0;
+    }
+
+  int run_files(const options& o)
+    {
+    uint32_t jobs = o.jobs ? o.jobs : std::max<uint32_t>(1, std::thread::hardware_concurrency());
+    jobs = std::min<uint32_t>(jobs, (uint32_t)o.inputs.size());
+    const uint64_t memory_budget = std::max<uint64_t>(1, o.memory_budget / std::max<uint32_t>(1, jobs));
+    std::atomic<size_t> next(0);
+    std::atomic<bool> failed(false);
+    std::mutex output_mutex;
+    auto run_job = [&]()
+      {
+      for (size_t i = next++; i < o.inputs.size(); i = next++)
+        {
+        try
+          {
+          const std::string line = process_file(o, o.inputs[i], memory_budget);
+          std::lock_guard<std::mutex> lock(output_mutex);
+          std::cout << line << std::endl;
+          }
+        catch (std::exception& e)
+          {
+          failed = true;
+          std::lock_guard<std::mutex> lock(output_mutex);
+          std::cerr << o.inputs[i] << ": " << e.what() << std::endl;
+          }
+        }
+      };
+    std::vector<std::thread> threads;
+    for (uint32_t j = 1; j < jobs; ++j)
+      threads.emplace_back(run_job);
+    run_job();
+    for (auto& t : threads)
+      t.join();
+    return failed ? 1 : 0;
+    }
+  }
+
+int main(int argc, char** argv)
+  {
+  int result = 0;
+  try
+    {
+    const options o = parse_options(argc, argv);
+    if (o.command == "help" || o.command == "--help")
+      {
+      print_usage();
+      return 0;
+      }
+    if (o.inputs.empty())
+      throw std::runtime_error("no input files");
+    if (o.command == "analyze")
+      result = run_analyze(o);
+    else if (o.block_levels >= 0 && (o.command == "compress" || o.command == "smooth"))
+      result = run_blocks(o);
+    else
+      result = run_files(o);
+    }
+  catch (std::exception& e)
+    {
+    std::cerr << "pief-cli: " << e.what() << "\n\n";
+    print_usage();
+    result = 2;
+    }
+  // the model code logs its warnings, those go to stderr here
+  const std::string messages = Logging::GetInstance().pop_messages();
+  if (!messages.empty())
+    std::cerr << messages;
+  return result;
+  }
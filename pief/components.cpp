@@ -0,0 +1,76 @@
+#include "components.h"
+
+#include <stdexcept>
+
+component_pyramid::component_pyramid() : _n(0), _levels(0), _s(haar)
+  {
+  }
+
+component_pyramid::component_pyramid(const std::vector<double>& values, int levels, scheme s, const std::vector<lifting_step>& custom_steps) : _n(values.size()), _levels(levels), _s(s),
+_coarse((size_t)levels + 1), _details((size_t)levels), _splines((size_t)levels + 1), _wavelets((size_t)levels)
+  {
+  if (levels < 0 || (levels > 0 && (_n >> levels) << levels != _n))
+    throw std::runtime_error("the number of samples must be a multiple of 2^levels");
+  if (s == custom)
+    _custom_steps = custom_steps;
+  // lifting level k of the full signal is lifting level 0 of its coarse samples
+  _coarse[0] = values;
+  for (int k = 0; k < levels; ++k)
+    {
+    std::vector<double> current = _coarse[k];
+    forward(current.data(), current.size(), 0, _s, _custom_steps);
+    const uint64_t half = current.size() / 2;
+    _coarse[k + 1].resize((size_t)half);
+    _details[k].resize((size_t)half);
+    for (uint64_t i = 0; i < half; ++i)
+      {
+      _coarse[k + 1][i] = current[2 * i];
+      _details[k][i] = current[2 * i + 1];
+      }
+    }
+  _splines[levels] = values;
+  }
+
+void component_pyramid::_synthesize(std::vector<double>& values, std::vector<double> current, int depth) const
+  {
+  // 'current' holds the samples of level 'depth', the details of all finer levels are zero
+  std::vector<double> finer;
+  for (int k = depth; k > 0; --k)
+    {
+    finer.assign(current.size() * 2, 0.0);
+    for (uint64_t i = 0; i < current.size(); ++i)
+      finer[2 * i] = current[i];
+    inverse(finer.data(), finer.size(), 0, _s, _custom_steps);
+    current.swap(finer);
+    }
+  values.swap(current);
+  }
+
+const std::vector<double>& component_pyramid::spline(int level)
+  {
+  if (level < 0 || level > _levels)
+    throw std::runtime_error("component level out of range");
+  if (_splines[level].empty())
+    {
+    const int depth = _levels - level;
+    _synthesize(_splines[level], _coarse[depth], depth);
+    }
+  return _splines[level];
+  }
+
+const std::vector<double>& component_pyramid::wavelet(int level)
+  {
+  if (level < 0 || level >= _levels)
+    throw std::runtime_error("component level out of range");
+  if (_wavelets[level].empty())
+    {
+    const int depth = _levels - level;
+    const std::vector<double>& d = _details[depth - 1];
+    std::vector<double> current(d.size() * 2, 0.0);
+    for (uint64_t i = 0; i < d.size(); ++i)
+      current[2 * i + 1] = d[i];
+    inverse(current.data(), current.size(), 0, _s, _custom_steps);
+    _synthesize(_wavelets[level], std::move(current), depth - 1);
+    }
+  return _wavelets[level];
+  }
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "model.h"
+
+#include <vector>
+#include <stdint.h>
+
+/*
+All spline and wavelet components of a signal.
+
+get_spline_component and get_wavelet_component each run a forward and an inverse transform for one level. This class
+runs the forward transform once and keeps the coarse samples and the details of every level. A component is then
+synthesized from its own level only, the first time it is asked for, and kept. The results equal those of
+get_spline_component and get_wavelet_component.
+*/
+class component_pyramid
+  {
+  public:
+    component_pyramid();
+    component_pyramid(const std::vector<double>& values, int levels, scheme s, const std::vector<lifting_step>& custom_steps);
+
+    bool empty() const { return _coarse.empty(); }
+    int levels() const { return _levels; }
+
+    // the same as get_spline_component for 'level' in [0, levels], levels gives the signal itself
+    const std::vector<double>& spline(int level);
+    // the same as get_wavelet_component for 'level' in [0, levels)
+    const std::vector<double>& wavelet(int level);
+
+  private:
+    void _synthesize(std::vector<double>& values, std::vector<double> current, int depth) const;
+
+  private:
+    uint64_t _n;
+    int _levels;
+    scheme _s;
+    std::vector<lifting_step> _custom_steps;
+    std::vector<std::vector<double>> _coarse; // _coarse[k] holds the n >> k coarse samples after k forward levels
+    std::vector<std::vector<double>> _details; // _details[k] holds the details of forward level k
+    std::vector<std::vector<double>> _splines, _wavelets;
+  };
@@ -0,0 +1,594 @@
+#include "daemon.h"
+#include "batch_analysis.h"
+#include "mapped_file.h"
+#include "model.h"
+#include "parallel.h"
+#include "parse.h"
+#include "pyramid_file.h"
+#include "roi.h"
+
+#include "../lifting/lifting.h"
+
+#include <json.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <stdexcept>
+#include <tuple>
+
+#include <sys/stat.h>
+
+namespace
+  {
+  typedef std::chrono::steady_clock clock_type;
+
+  const char* operations[] = { "forward", "inverse", "compress", "smooth", "roi", "analyze", "metrics", "shutdown" };
+
+  const size_t max_cached_plans = 256;
+  const size_t max_cached_pyramids = 16;
+  // latencies are counted in buckets of powers of two microseconds
+  const int latency_buckets = 40;
+
+  double seconds_since(clock_type::time_point start)
+    {
+    return std::chrono::duration<double>(clock_type::now() - start).count();
+    }
+
+  std::string dump(const nlohmann::json& j)
+    {
+    return j.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace);
+    }
+
+  std::string error_response(const nlohmann::json& id, const std::string& error)
+    {
+    nlohmann::json j;
+    j["id"] = id;
+    j["ok"] = false;
+    j["error"] = error;
+    return dump(j);
+    }
+
+  uint32_t get_levels(const nlohmann::json& request, uint64_t n)
+    {
+    return request.contains("levels") ? request["levels"].get<uint32_t>() : default_levels(n);
+    }
+
+  // "/dev/shm/name", or the name "/name" or "name" as given to shm_open
+  std::string get_shm_filename(const std::string& shm)
+    {
+    const std::string folder = "/dev/shm/";
+    std::string name = shm;
+    if (name.compare(0, folder.size(), folder) == 0)
+      name.erase(0, folder.size());
+    else if (!name.empty() && name[0] == '/')
+      name.erase(0, 1);
+    if (name.empty() || name == "." || name == ".." || name.find('/') != std::string::npos)
+      throw std::runtime_error("shm must name a file in " + folder);
+    return folder + name;
+    }
+
+  std::filesystem::file_time_type get_write_time(const std::string& filename)
+    {
+    std::error_code ec;
+    return std::filesystem::last_write_time(filename, ec);
+    }
+  }
+
+struct transform_service::pending_request
+  {
+  nlohmann::json request;
+  std::string op;
+  clock_type::time_point received;
+  std::promise<std::string> response;
+
+  // the payload, either the inline values or a view into the shared memory file
+  std::vector<double> values;
+  mapped_file shm;
+  double* data = nullptr;
+  uint64_t n = 0;
+  uint64_t shm_device = 0, shm_inode = 0, shm_first = 0; // the file and the first sample of the shm range
+
+  // the region of a roi request
+  uint64_t first = 0;
+  uint32_t level = 0;
+
+  nlohmann::json result;
+  std::string error;
+  double service_seconds = 0.0;
+  };
+
+struct transform_service::plan
+  {
+  scheme s = jamlet_linear;
+  std::vector<lifting_step> custom_steps;
+  std::string error; // of the script
+  uint64_t last_used = 0;
+  };
+
+struct transform_service::cached_pyramid
+  {
+  std::unique_ptr<pyramid_file> file;
+  std::filesystem::file_time_type write_time;
+  std::string error;
+  uint64_t last_used = 0;
+  };
+
+struct transform_service::operation_metrics
+  {
+  uint64_t requests = 0;
+  uint64_t errors = 0;
+  uint64_t samples = 0;
+  double latency_seconds = 0.0; // from submit to response, summed
+  double max_latency_seconds = 0.0;
+  double service_seconds = 0.0; // of the transforms themselves, summed
+  uint64_t histogram[latency_buckets] = {};
+  };
+
+transform_service::transform_service(const daemon_settings& settings) : _settings(settings), _start(clock_type::now()),
+_stop(false), _batches(0), _batched_requests(0)
+  {
+  if (_settings.max_batch == 0)
+    _settings.max_batch = 1;
+  _dispatcher = std::thread([this]() { _dispatch(); });
+  }
+
+transform_service::~transform_service()
+  {
+    {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stop = true;
+    }
+  _wake.notify_all();
+  _dispatcher.join();
+  }
+
+bool transform_service::stopped() const
+  {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _stop;
+  }
+
+std::future<std::string> transform_service::submit(const std::string& request)
+  {
+  auto r = std::make_shared<pending_request>();
+  r->received = clock_type::now();
+  std::future<std::string> response = r->response.get_future();
+  // parsed by the connection threads, so that the dispatcher only transforms
+  try
+    {
+    r->request = nlohmann::json::parse(request);
+    if (!r->request.is_object())
+      throw std::runtime_error("a request is a JSON object");
+    r->op = r->request.value("op", std::string());
+    if (std::find(std::begin(operations), std::end(operations), r->op) == std::end(operations))
+      throw std::runtime_error("unknown op '" + r->op + "'");
+    // the dispatcher groups requests by these
+    for (const char* field : { "scheme", "script", "pyramid", "name", "shm" })
+      {
+      if (r->request.contains(field) && !r->request[field].is_string())
+        throw std::runtime_error(std::string(field) + " is not a string");
+      }
+    }
+  catch (std::exception& e)
+    {
+    r->response.set_value(error_response(r->request.is_object() && r->request.contains("id") ? r->request["id"] : nlohmann::json(), e.what()));
+    return response;
+    }
+    {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_stop)
+      {
+      r->response.set_value(error_response(r->request.value("id", nlohmann::json()), "the daemon is stopping"));
+      return response;
+      }
+    _queue.push_back(r);
+    }
+  _wake.notify_one();
+  return response;
+  }
+
+void transform_service::_dispatch()
+  {
+  for (;;)
+    {
+    std::vector<std::shared_ptr<pending_request>> batch;
+      {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _wake.wait(lock, [this]() { return _stop || !_queue.empty(); });
+      if (_stop)
+        break;
+      // small requests that arrive close together are transformed together
+      const clock_type::time_point deadline = _queue.front()->received + std::chrono::microseconds(_settings.batch_window_us);
+      _wake.wait_until(lock, deadline, [this]() { return _stop || _queue.size() >= _settings.max_batch; });
+      while (!_queue.empty() && batch.size() < _settings.max_batch)
+        {
+        batch.push_back(_queue.front());
+        _queue.pop_front();
+        }
+      }
+    _process(batch);
+    }
+  std::lock_guard<std::mutex> lock(_mutex);
+  for (auto& r : _queue)
+    r->response.set_value(error_response(r->request.value("id", nlohmann::json()), "the daemon is stopping"));
+  _queue.clear();
+  }
+
+void transform_service::_process(std::vector<std::shared_ptr<pending_request>>& batch)
+  {
+  ++_batches;
+  _batched_requests += batch.size();
+
+  // groups of requests that share a plan, in the order of their first request
+  std::vector<std::string> keys;
+  std::map<std::string, std::vector<pending_request*>> groups;
+  std::vector<pending_request*> controls;
+  for (auto& r : batch)
+    {
+    std::string key;
+    if (r->op == "metrics" || r->op == "shutdown")
+      {
+      controls.push_back(r.get());
+      continue;
+      }
+    if (r->op == "analyze")
+      key = "analyze";
+    else if (r->op == "roi")
+      key = "roi|" + r->request.value("pyramid", std::string());
+    else
+      key = r->op + "|" + r->request.value("scheme", std::string()) + "|" + r->request.value("script", std::string());
+    auto& group = groups[key];
+    if (group.empty())
+      keys.push_back(key);
+    group.push_back(r.get());
+    }
+
+  // the plans and payloads are resolved first, so that the shm ranges of the whole batch can be checked
+  std::vector<const plan*> plans(keys.size(), nullptr);
+  std::vector<const cached_pyramid*> pyramids(keys.size(), nullptr);
+  std::vector<pending_request*> shared;
+  for (size_t g = 0; g < keys.size(); ++g)
+    {
+    std::vector<pending_request*>& group = groups[keys[g]];
+    const pending_request& front = *group.front();
+    if (front.op == "analyze")
+      continue;
+    if (front.op == "roi")
+      pyramids[g] = &_get_pyramid(front.request.value("pyramid", std::string()));
+    else
+      {
+      const std::string script = front.request.value("script", std::string());
+      plans[g] = &_get_plan(script.empty() ? front.request.value("scheme", std::string("jamlet_linear")) : std::string(), script);
+      }
+    for (pending_request* r : group)
+      {
+      try
+        {
+        _prepare(*r, plans[g], pyramids[g]);
+        if (r->shm.is_open())
+          shared.push_back(r);
+        }
+      catch (std::exception& e)
+        {
+        r->error = e.what();
+        }
+      }
+    }
+
+  // requests of a batch run in parallel, so two of them must not transform the same samples
+  std::sort(shared.begin(), shared.end(), [](const pending_request* a, const pending_request* b)
+    {
+    return std::tie(a->shm_device, a->shm_inode, a->shm_first) < std::tie(b->shm_device, b->shm_inode, b->shm_first);
+    });
+  for (size_t i = 1, owner = 0; i < shared.size(); ++i)
+    {
+    const pending_request& a = *shared[owner];
+    pending_request& b = *shared[i];
+    if (a.shm_device == b.shm_device && a.shm_inode == b.shm_inode && b.shm_first < a.shm_first + a.n)
+      b.error = "the shm range overlaps the range of another request in the batch";
+    else
+      owner = i;
+    }
+
+  for (size_t g = 0; g < keys.size(); ++g)
+    {
+    std::vector<pending_request*>& group = groups[keys[g]];
+    if (group.front()->op == "analyze")
+      {
+      const clock_type::time_point t0 = clock_type::now();
+      std::vector<batch_scheme> schemes(group.size());
+      for (size_t i = 0; i < group.size(); ++i)
+        {
+        schemes[i].name = group[i]->request.value("name", std::string("script"));
+        schemes[i].script = group[i]->request.value("script", std::string());
+        }
+      const std::vector<std::string> records = analyze_batch(schemes);
+      const double seconds = seconds_since(t0) / (double)group.size();
+      for (size_t i = 0; i < group.size(); ++i)
+        {
+        group[i]->result["analysis"] = nlohmann::json::parse(records[i]);
+        group[i]->service_seconds = seconds;
+        }
+      continue;
+      }
+    parallel_for(0, group.size(), [&](uint64_t i)
+      {
+      pending_request& r = *group[i];
+      if (!r.error.empty())
+        return;
+      const clock_type::time_point t0 = clock_type::now();
+      try
+        {
+        _transform(r, plans[g], pyramids[g]);
+        }
+      catch (std::exception& e)
+        {
+        r.error = e.what();
+        }
+      r.service_seconds = seconds_since(t0);
+      });
+    }
+
+  for (auto& r : batch)
+    {
+    if (r->op == "metrics" || r->op == "shutdown")
+      continue;
+    r->shm.close();
+    r->result["id"] = r->request.value("id", nlohmann::json());
+    r->result["ok"] = r->error.empty();
+    if (!r->error.empty())
+      r->result["error"] = r->error;
+    const std::string response = dump(r->result);
+    r->response.set_value(response);
+    _record(r->op, r->received, r->service_seconds, r->error.empty() ? r->n : 0, !r->error.empty());
+    }
+
+  // after the transforms, so that the metrics include this batch
+  for (pending_request* r : controls)
+    {
+    if (r->op == "metrics")
+      _metrics(*r);
+    r->result["id"] = r->request.value("id", nlohmann::json());
+    r->result["ok"] = true;
+    if (r->op == "shutdown")
+      {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _stop = true;
+      }
+    r->response.set_value(dump(r->result));
+    }
+  }
+
+void transform_service::_prepare(pending_request& r, const plan* p, const cached_pyramid* pyr)
+  {
+  const nlohmann::json& request = r.request;
+  if (pyr && !pyr->error.empty())
+    throw std::runtime_error(pyr->error);
+  if (p && !p->error.empty())
+    throw std::runtime_error(p->error);
+
+  uint64_t first = 0, last = 0;
+  if (pyr)
+    {
+    first = request.value("first", (uint64_t)0);
+    last = request.value("last", pyr->file->size());
+    r.level = request.value("level", (uint32_t)0);
+    if (r.level > pyr->file->levels() || first > last || last > (pyr->file->size() >> r.level))
+      throw std::runtime_error("the region is outside the pyramid");
+    r.first = first;
+    }
+
+  // the payload
+  if (request.contains("shm"))
+    {
+    const std::string filename = get_shm_filename(request["shm"].get<std::string>());
+    // lstat does not follow a symbolic link, so a link in /dev/shm is no regular file
+    struct stat info;
+    if (::lstat(filename.c_str(), &info) != 0 || !S_ISREG(info.st_mode))
+      throw std::runtime_error(filename + " is not a regular file");
+    r.shm.open(filename, mapped_file::WRITE);
+    r.shm_device = (uint64_t)info.st_dev;
+    r.shm_inode = (uint64_t)info.st_ino;
+    const uint64_t available = r.shm.size() / sizeof(double);
+    const uint64_t offset = request.value("offset", (uint64_t)0);
+    if (offset > available)
+      throw std::runtime_error("the offset is beyond the end of " + filename);
+    r.n = request.value("count", pyr ? last - first : available - offset);
+    if (r.n > available - offset)
+      throw std::runtime_error("the count is beyond the end of " + filename);
+    r.shm_first = offset;
+    r.data = (double*)r.shm.data() + offset;
+    }
+  else if (pyr)
+    {
+    r.values.resize(last - first);
+    r.n = r.values.size();
+    r.data = r.values.data();
+    }
+  else
+    {
+    if (!request.contains("values"))
+      throw std::runtime_error("the request has no values and no shm");
+    r.values = request["values"].get<std::vector<double>>();
+    r.n = r.values.size();
+    r.data = r.values.data();
+    }
+
+  if (pyr && r.n != last - first)
+    throw std::runtime_error("the count differs from the size of the region");
+  }
+
+void transform_service::_transform(pending_request& r, const plan* p, const cached_pyramid* pyr)
+  {
+  const nlohmann::json& request = r.request;
+  if (pyr)
+    decode_region(r.data, *pyr->file, r.first, r.first + r.n, r.level);
+  else
+    {
+    const uint32_t levels = get_levels(request, r.n);
+    if (levels > 62 || r.n == 0 || !lifting::is_multiple_of_power_of_two(r.n, levels))
+      throw std::runtime_error("the number of values is not a multiple of 2^levels");
+    if (r.op != "inverse")
+      {
+      for (uint32_t lev = 0; lev < levels; ++lev)
+        forward(r.data, r.n, lev, p->s, p->custom_steps);
+      }
+    if (r.op == "compress")
+      r.result["compressed"] = lifting::compress(r.data, r.n, request.value("threshold", 0.01), levels);
+    else if (r.op == "smooth")
+      lifting::smooth(r.data, r.n, request.value("threshold", 0.01), levels);
+    if (r.op != "forward")
+      {
+      for (uint32_t lev = levels; lev > 0; --lev)
+        inverse(r.data, r.n, lev - 1, p->s, p->custom_steps);
+      }
+    }
+
+  if (r.shm.is_open())
+    r.shm.flush();
+  else
+    r.result["values"] = r.values;
+  }
+
+const transform_service::plan& transform_service::_get_plan(const std::string& scheme_name, const std::string& script)
+  {
+  const std::string key = scheme_name + "|" + script;
+  auto it = _plans.find(key);
+  if (it == _plans.end())
+    {
+    // plans of the current batch are in use
+    if (_plans.size() >= max_cached_plans)
+      {
+      auto oldest = std::min_element(_plans.begin(), _plans.end(), [](const auto& a, const auto& b) { return a.second->last_used < b.second->last_used; });
+      if (oldest->second->last_used < _batches)
+        _plans.erase(oldest);
+      }
+    auto p = std::make_unique<plan>();
+    if (!script.empty())
+      {
+      p->s = custom;
+      try
+        {
+        compile(p->custom_steps, script);
+        if (p->custom_steps.empty())
+          p->error = "the script has no steps";
+        }
+      catch (std::exception& e)
+        {
+        p->error = e.what();
+        }
+      }
+    else
+      {
+      try
+        {
+        p->s = scheme_from_name(scheme_name);
+        }
+      catch (std::exception& e)
+        {
+        p->s = custom;
+        p->error = e.what();
+        }
+      }
+    it = _plans.emplace(key, std::move(p)).first;
+    }
+  it->second->last_used = _batches;
+  return *it->second;
+  }
+
+const transform_service::cached_pyramid& transform_service::_get_pyramid(const std::string& filename)
+  {
+  const std::filesystem::file_time_type write_time = get_write_time(filename);
+  auto it = _pyramids.find(filename);
+  // a pyramid that was rewritten since it was mapped is mapped again
+  if (it != _pyramids.end() && (it->second->write_time != write_time || !it->second->error.empty()))
+    {
+    _pyramids.erase(it);
+    it = _pyramids.end();
+    }
+  if (it == _pyramids.end())
+    {
+    if (_pyramids.size() >= max_cached_pyramids)
+      {
+      auto oldest = std::min_element(_pyramids.begin(), _pyramids.end(), [](const auto& a, const auto& b) { return a.second->last_used < b.second->last_used; });
+      if (oldest->second->last_used < _batches)
+        _pyramids.erase(oldest);
+      }
+    auto pyr = std::make_unique<cached_pyramid>();
+    pyr->write_time = write_time;
+    try
+      {
+      pyr->file = std::make_unique<pyramid_file>(filename);
+      }
+    catch (std::exception& e)
+      {
+      pyr->error = e.what();
+      }
+    it = _pyramids.emplace(filename, std::move(pyr)).first;
+    }
+  it->second->last_used = _batches;
+  return *it->second;
+  }
+
+void transform_service::_record(const std::string& op, clock_type::time_point received, double service_seconds, uint64_t samples, bool error)
+  {
+  std::unique_ptr<operation_metrics>& m = _operations[op];
+  if (!m)
+    m = std::make_unique<operation_metrics>();
+  const double latency = seconds_since(received);
+  ++m->requests;
+  if (error)
+    ++m->errors;
+  m->samples += samples;
+  m->latency_seconds += latency;
+  m->max_latency_seconds = std::max(m->max_latency_seconds, latency);
+  m->service_seconds += service_seconds;
+  int bucket = 0;
+  for (uint64_t us = (uint64_t)(latency * 1e6); us > 1 && bucket < latency_buckets - 1; us >>= 1)
+    ++bucket;
+  ++m->histogram[bucket];
+  }
+
+void transform_service::_metrics(pending_request& r) const
+  {
+  nlohmann::json& j = r.result;
+  const double uptime = seconds_since(_start);
+  j["uptime_seconds"] = uptime;
+  j["batches"] = _batches;
+  j["mean_batch_size"] = _batches ? (double)_batched_requests / (double)_batches : 0.0;
+  j["cached_plans"] = _plans.size();
+  j["cached_pyramids"] = _pyramids.size();
+  j["batch_window_us"] = _settings.batch_window_us;
+  j["max_batch"] = _settings.max_batch;
+  nlohmann::json ops = nlohmann::json::object();
+  for (const auto& op : _operations)
+    {
+    const operation_metrics& m = *op.second;
+    // the percentiles are the upper bounds of their power of two bucket
+    auto percentile = [&](double q)
+      {
+      const uint64_t rank = (uint64_t)std::ceil(q * (double)m.requests);
+      uint64_t count = 0;
+      for (int b = 0; b < latency_buckets; ++b)
+        {
+        count += m.histogram[b];
+        if (count >= rank)
+          return (double)((uint64_t)2 << b);
+        }
+      return (double)((uint64_t)2 << (latency_buckets - 1));
+      };
+    nlohmann::json o;
+    o["requests"] = m.requests;
+    o["errors"] = m.errors;
+    o["samples"] = m.samples;
+    o["mean_latency_us"] = m.requests ? 1e6 * m.latency_seconds / (double)m.requests : 0.0;
+    o["max_latency_us"] = 1e6 * m.max_latency_seconds;
+    o["p50_latency_us"] = percentile(0.5);
+    o["p99_latency_us"] = percentile(0.99);
+    o["requests_per_second"] = uptime > 0.0 ? (double)m.requests / uptime : 0.0;
+    o["samples_per_second"] = m.service_seconds > 0.0 ? (double)m.samples / m.service_seconds : 0.0;
+    ops[op.first] = o;
+    }
+  j["operations"] = ops;
+  }
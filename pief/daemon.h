@@ -0,0 +1,97 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+/*
+The transforms of pief as a local service, so that programs need not link lifting.h for one-off transforms.
+pief-daemon (daemon_main.cpp) serves it on a Unix domain socket.
+
+Requests and responses are JSON objects, one per line. Every response echoes the "id" of its request and has "ok",
+and "error" when ok is false.
+
+  {"op": "forward" | "inverse", "scheme": "cdf_9_7", "levels": 4, "values": [...]}
+  {"op": "compress", "threshold": 0.01, ...}            hard thresholding, as compress in model.h, returns "compressed"
+  {"op": "smooth", "threshold": 0.01, ...}              soft thresholding of the 'levels' finest levels, as smooth
+  {"op": "roi", "pyramid": "x.pyr", "first": 0, "last": 100, "level": 0}   decode_region of roi.h
+  {"op": "analyze", "script": "..."}                    the record of analyze_batch in "analysis"
+  {"op": "metrics"}                                     latency and throughput per operation
+  {"op": "shutdown"}
+
+A custom scheme is given by "script" instead of "scheme". "levels" defaults to the most the signal allows up to 12.
+Instead of "values" a request can name a file in shared memory ("shm": "/dev/shm/name", or the name given to
+shm_open, with "offset" and "count" in doubles), which the daemon maps and transforms in place, so large payloads
+are never copied through the socket. The response then has no values. ROI decoding writes its result to the shm file
+in the same way. Only regular files directly in /dev/shm are accepted, no other paths and no symbolic links, and a
+request whose range overlaps that of an earlier request in the same batch is rejected.
+
+Requests are queued and taken in batches: the dispatcher waits batch_window_us after the first request for others to
+arrive. Requests of a batch that share an operation and a scheme share their compiled steps and are run in parallel,
+all analyses of a batch go to one analyze_batch, and all ROI requests on one pyramid share its mapping. Compiled
+scripts and mapped pyramids stay cached between batches.
+*/
+
+struct daemon_settings
+  {
+  uint32_t batch_window_us = 200;
+  uint32_t max_batch = 256;
+  };
+
+class transform_service
+  {
+  public:
+    explicit transform_service(const daemon_settings& settings = daemon_settings());
+    ~transform_service();
+
+    transform_service(const transform_service&) = delete;
+    transform_service& operator = (const transform_service&) = delete;
+
+    // queues a request line, the future gets the response line (without newline)
+    std::future<std::string> submit(const std::string& request);
+
+    // true once a shutdown request was answered
+    bool stopped() const;
+
+  private:
+    struct pending_request;
+    struct plan;
+    struct operation_metrics;
+    struct cached_pyramid;
+
+    void _dispatch();
+    void _process(std::vector<std::shared_ptr<pending_request>>& batch);
+    // maps the payload and checks the request, in the dispatcher thread
+    void _prepare(pending_request& r, const plan* p, const cached_pyramid* pyr);
+    // runs in parallel with the other requests of the group
+    void _transform(pending_request& r, const plan* p, const cached_pyramid* pyr);
+    void _metrics(pending_request& r) const;
+    void _record(const std::string& op, std::chrono::steady_clock::time_point received, double service_seconds, uint64_t samples, bool error);
+    const plan& _get_plan(const std::string& scheme_name, const std::string& script);
+    const cached_pyramid& _get_pyramid(const std::string& filename);
+
+  private:
+    daemon_settings _settings;
+    std::chrono::steady_clock::time_point _start;
+
+    mutable std::mutex _mutex;
+    std::condition_variable _wake;
+    std::deque<std::shared_ptr<pending_request>> _queue;
+    bool _stop;
+
+    // only used by the dispatcher thread
+    std::map<std::string, std::unique_ptr<plan>> _plans;
+    std::map<std::string, std::unique_ptr<cached_pyramid>> _pyramids;
+    uint64_t _batches, _batched_requests;
+    std::map<std::string, std::unique_ptr<operation_metrics>> _operations;
+
+    std::thread _dispatcher;
+  };
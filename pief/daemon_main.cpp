@@ -0,0 +1,347 @@
+/*
+pief-daemon: a transform_service (daemon.h) on a Unix domain socket.
+
+Every connection gets a thread that reads request lines, submits them as they arrive and writes the responses in
+the order of the requests, so a client can pipeline many requests on one connection and have them batched.
+With --send it is a client instead, that sends one request and prints the response, for scripts and tests.
+*/
+
+#include "daemon.h"
+#include "logging.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace
+  {
+  struct options
+    {
+    std::string socket_path;
+    std::string send; // the request of --send
+    daemon_settings settings;
+    };
+
+  void print_usage()
+    {
+    std::cout << "usage: pief-daemon <socket> [options]\n";
+    std::cout << "       pief-daemon --send <socket> <request>\n\n";
+    std::cout << "options:\n";
+    std::cout << "  --batch-window <us>    how long a request waits for others to batch with, default " << daemon_settings().batch_window_us << "\n";
+    std::cout << "  --max-batch <n>        requests per batch, default " << daemon_settings().max_batch << "\n\n";
+    std::cout << "requests are JSON lines, see daemon.h, e.g.\n";
+    std::cout << "  {\"id\": 1, \"op\": \"compress\", \"scheme\": \"cdf_9_7\", \"threshold\": 0.1, \"values\": [1, 2, 3, 4]}\n";
+    }
+
+  options parse_options(int argc, char** argv)
+    {
+    options o;
+    for (int i = 1; i < argc; ++i)
+      {
+      const std::string arg = argv[i];
+      if (arg.size() < 2 || arg.compare(0, 2, "--") != 0)
+        {
+        if (!o.socket_path.empty())
+          throw std::runtime_error("more than one socket");
+        o.socket_path = arg;
+        continue;
+        }
+      if (i + 1 >= argc)
+        throw std::runtime_error(arg + " needs a value");
+      const std::string value = argv[++i];
+      if (arg == "--batch-window")
+        o.settings.batch_window_us = (uint32_t)std::stoul(value);
+      else if (arg == "--max-batch")
+        o.settings.max_batch = (uint32_t)std::stoul(value);
+      else if (arg == "--send")
+        {
+        if (i + 1 >= argc)
+          throw std::runtime_error("--send needs a socket and a request");
+        o.socket_path = value;
+        o.send = argv[++i];
+        }
+      else
+        throw std::runtime_error("unknown option " + arg);
+      }
+    if (o.socket_path.empty())
+      throw std::runtime_error("no socket");
+    return o;
+    }
+
+  sockaddr_un make_address(const std::string& path)
+    {
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path))
+      throw std::runtime_error("the socket path is too long");
+    memcpy(address.sun_path, path.c_str(), path.size());
+    return address;
+    }
+
+  bool send_all(int fd, const std::string& text)
+    {
+    size_t sent = 0;
+    while (sent < text.size())
+      {
+      const ssize_t n = ::send(fd, text.data() + sent, text.size() - sent, MSG_NOSIGNAL);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        return false;
+      sent += (size_t)n;
+      }
+    return true;
+    }
+
+  class connection
+    {
+    public:
+      connection(int fd, transform_service& service) : _fd(fd), _service(service), _closed(false)
+        {
+        _writer = std::thread([this]() { _write(); });
+        _reader = std::thread([this]() { _read(); });
+        }
+
+      ~connection()
+        {
+        close();
+        _reader.join();
+        _writer.join();
+        ::close(_fd);
+        }
+
+      // wakes the reader of a client that keeps the connection open
+      void close()
+        {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_closed)
+          ::shutdown(_fd, SHUT_RDWR);
+        _closed = true;
+        }
+
+      // the client closed the connection and got all its responses
+      bool finished() const { return _finished; }
+
+    private:
+      // the responses are written by another thread, so that reading the next requests does not wait for them
+      void _read()
+        {
+        std::string buffer;
+        char chunk[65536];
+        for (;;)
+          {
+          const ssize_t n = ::recv(_fd, chunk, sizeof(chunk), 0);
+          if (n < 0 && errno == EINTR)
+            continue;
+          if (n <= 0)
+            break;
+          buffer.append(chunk, (size_t)n);
+          size_t first = 0;
+          for (size_t eol = buffer.find('\n'); eol != std::string::npos; eol = buffer.find('\n', first))
+            {
+            const std::string line = buffer.substr(first, eol - first);
+            first = eol + 1;
+            if (line.find_first_not_of(" \t\r") == std::string::npos)
+              continue;
+            _push(_service.submit(line));
+            }
+          buffer.erase(0, first);
+          }
+        std::lock_guard<std::mutex> lock(_mutex);
+        _end_of_requests = true;
+        _wake.notify_one();
+        }
+
+      void _push(std::future<std::string> response)
+        {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _responses.push_back(std::move(response));
+        _wake.notify_one();
+        }
+
+      void _write()
+        {
+        bool failed = false;
+        for (;;)
+          {
+          std::future<std::string> response;
+            {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _wake.wait(lock, [this]() { return _end_of_requests || !_responses.empty(); });
+            if (_responses.empty())
+              break;
+            response = std::move(_responses.front());
+            _responses.pop_front();
+            }
+          // the responses of a client that went away are still waited for, the service owns their buffers
+          const std::string line = response.get() + "\n";
+          if (!failed && !send_all(_fd, line))
+            failed = true;
+          }
+        _finished = true;
+        }
+
+    private:
+      int _fd;
+      transform_service& _service;
+      std::mutex _mutex;
+      std::condition_variable _wake;
+      std::deque<std::future<std::string>> _responses;
+      bool _end_of_requests = false;
+      bool _closed;
+      std::atomic<bool> _finished{false};
+      std::thread _reader;
+      std::thread _writer;
+    };
+
+  void drain_log()
+    {
+    const std::string messages = Logging::GetInstance().pop_messages();
+    if (!messages.empty())
+      std::cerr << messages;
+    }
+
+  // only a socket left behind by a daemon that was killed is removed, any other file at the path is an error
+  void remove_stale_socket(const std::string& path, const sockaddr_un& address)
+    {
+    struct stat info;
+    if (::lstat(path.c_str(), &info) != 0)
+      {
+      if (errno == ENOENT)
+        return;
+      throw std::runtime_error("cannot check " + path + ": " + strerror(errno));
+      }
+    if (!S_ISSOCK(info.st_mode))
+      throw std::runtime_error(path + " exists and is not a socket");
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+      throw std::runtime_error("cannot create a socket");
+    const bool in_use = ::connect(fd, (const sockaddr*)&address, sizeof(address)) == 0;
+    const int error = errno;
+    ::close(fd);
+    if (in_use)
+      throw std::runtime_error("another daemon is listening on " + path);
+    if (error != ECONNREFUSED)
+      throw std::runtime_error("cannot check " + path + ": " + strerror(error));
+    ::unlink(path.c_str());
+    }
+
+  int serve(const options& o)
+    {
+    const sockaddr_un address = make_address(o.socket_path);
+    remove_stale_socket(o.socket_path, address);
+    const int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0)
+      throw std::runtime_error("cannot create a socket");
+    if (::bind(listener, (const sockaddr*)&address, sizeof(address)) != 0 || ::listen(listener, 64) != 0)
+      {
+      ::close(listener);
+      throw std::runtime_error("cannot listen on " + o.socket_path + ": " + strerror(errno));
+      }
+    std::cerr << "pief-daemon: listening on " << o.socket_path << "\n";
+
+    int result = 0;
+      {
+      transform_service service(o.settings);
+      std::list<std::unique_ptr<connection>> connections;
+      while (!service.stopped())
+        {
+        pollfd p = { listener, POLLIN, 0 };
+        const int ready = ::poll(&p, 1, 100);
+        if (ready < 0 && errno != EINTR)
+          {
+          std::cerr << "pief-daemon: " << strerror(errno) << "\n";
+          result = 1;
+          break;
+          }
+        drain_log();
+        connections.remove_if([](const std::unique_ptr<connection>& c) { return c->finished(); });
+        if (ready <= 0)
+          continue;
+        const int fd = ::accept(listener, nullptr, nullptr);
+        if (fd >= 0)
+          connections.push_back(std::make_unique<connection>(fd, service));
+        }
+      // the clients that are still connected get the responses of the requests that were answered
+      for (auto& c : connections)
+        c->close();
+      connections.clear();
+      }
+    ::close(listener);
+    ::unlink(o.socket_path.c_str());
+    drain_log();
+    return result;
+    }
+
+  int send_request(const options& o)
+    {
+    const sockaddr_un address = make_address(o.socket_path);
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+      throw std::runtime_error("cannot create a socket");
+    if (::connect(fd, (const sockaddr*)&address, sizeof(address)) != 0)
+      {
+      ::close(fd);
+      throw std::runtime_error("cannot connect to " + o.socket_path + ": " + strerror(errno));
+      }
+    if (!send_all(fd, o.send + "\n"))
+      {
+      ::close(fd);
+      throw std::runtime_error("cannot send the request");
+      }
+    ::shutdown(fd, SHUT_WR);
+    std::string response;
+    char chunk[65536];
+    ssize_t n;
+    while ((n = ::recv(fd, chunk, sizeof(chunk), 0)) > 0 || (n < 0 && errno == EINTR))
+      {
+      if (n > 0)
+        response.append(chunk, (size_t)n);
+      }
+    ::close(fd);
+    std::cout << response;
+    return response.find("\"ok\":true") != std::string::npos ? 0 : 1;
+    }
+  }
+
+int main(int argc, char** argv)
+  {
+  int result = 0;
+  try
+    {
+    if (argc < 2 || std::string(argv[1]) == "--help" || std::string(argv[1]) == "help")
+      {
+      print_usage();
+      return argc < 2 ? 2 : 0;
+      }
+    const options o = parse_options(argc, argv);
+    // a client that disconnects must not kill the daemon
+    signal(SIGPIPE, SIG_IGN);
+    result = o.send.empty() ? serve(o) : send_request(o);
+    }
+  catch (std::exception& e)
+    {
+    std::cerr << "pief-daemon: " << e.what() << "\n\n";
+    print_usage();
+    result = 2;
+    }
+  return result;
+  }
@@ -0,0 +1,215 @@
+#include "incremental.h"
+
+#include "../lifting/lifting.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+  {
+  void add(pair_range& r, uint64_t first, uint64_t last)
+    {
+    if (r.empty())
+      {
+      r.first = first;
+      r.last = last;
+      }
+    else
+      {
+      r.first = std::min(r.first, first);
+      r.last = std::max(r.last, last);
+      }
+    }
+
+  std::vector<double> get_interleaved(const pyramid_file& pyramid)
+    {
+    std::vector<double> coefficients((size_t)pyramid.size());
+    pyramid.to_interleaved(coefficients.data());
+    return coefficients;
+    }
+
+  pair_range hull(const pair_range& a, const pair_range& b)
+    {
+    pair_range r = a;
+    if (!b.empty())
+      add(r, b.first, b.last);
+    return r;
+    }
+  }
+
+incremental_synthesis::incremental_synthesis(uint64_t n, uint32_t levels, scheme s, const std::vector<lifting_step>& custom_steps) : _n(n), _levels(levels),
+_steps(get_lifting_steps(s, custom_steps)), _coefficients((size_t)n, 0.0), _samples(levels), _dirty_details(levels, pair_range{ 0, 0 }), _dirty_coarse{ 0, 0 }
+  {
+  if (levels == 0 || levels > 62 || !lifting::is_multiple_of_power_of_two(n, levels) || (n >> levels) == 0)
+    throw std::runtime_error("the number of samples must be a nonzero multiple of 2^levels");
+  for (uint32_t l = 0; l < levels; ++l)
+    _samples[l].resize((size_t)(n >> l), 0.0);
+  }
+
+void incremental_synthesis::reset(const double* coefficients)
+  {
+  std::copy(coefficients, coefficients + _n, _coefficients.begin());
+  _dirty_coarse = { 0, _n >> _levels };
+  for (uint32_t l = 0; l < _levels; ++l)
+    _dirty_details[l] = { 0, _n >> (l + 1) };
+  update();
+  }
+
+void incremental_synthesis::set_coefficient(uint64_t index, double value)
+  {
+  if (index >= _n)
+    throw std::runtime_error("coefficient index out of range");
+  _coefficients[index] = value;
+  if ((index & (((uint64_t)1 << _levels) - 1)) == 0)
+    {
+    const uint64_t k = index >> _levels;
+    add(_dirty_coarse, k, k + 1);
+    }
+  else
+    {
+    uint32_t level = 0;
+    while (((index >> level) & 1) == 0)
+      ++level;
+    const uint64_t k = index >> (level + 1);
+    add(_dirty_details[level], k, k + 1);
+    }
+  }
+
+pair_range incremental_synthesis::update()
+  {
+  // 'dirty' holds the changed samples of level l + 1, which are the even samples of the pairs of level l
+  pair_range dirty = _dirty_coarse;
+  std::vector<double> window;
+  for (uint32_t l = _levels; l > 0; --l)
+    {
+    const uint32_t lev = l - 1;
+    const uint64_t nr_of_pairs = (_n >> lev) / 2;
+    pair_range affected = hull(dirty, _dirty_details[lev]);
+    _dirty_details[lev] = { 0, 0 };
+    if (affected.empty())
+      {
+      dirty = affected;
+      continue;
+      }
+    for (size_t k = _steps.size(); k > 0; --k)
+      affected = spread(affected, _steps[k - 1], nr_of_pairs);
+
+    pair_range input;
+    const auto ranges = inverse_ranges(_steps, affected, nr_of_pairs, input);
+    window.resize((size_t)(2 * (input.last - input.first)));
+    for (uint64_t p = input.first; p < input.last; ++p)
+      {
+      window[2 * (p - input.first)] = l == _levels ? _coefficients[p << _levels] : _samples[l][p];
+      window[2 * (p - input.first) + 1] = _coefficients[((p << 1) + 1) << lev];
+      }
+    inverse_range(window.data(), _n >> lev, 0, _steps, ranges, 2 * input.first);
+    std::copy(window.begin() + 2 * (affected.first - input.first), window.begin() + 2 * (affected.last - input.first), _samples[lev].begin() + 2 * affected.first);
+    dirty = { 2 * affected.first, 2 * affected.last };
+    }
+  _dirty_coarse = { 0, 0 };
+  return dirty;
+  }
+
+incremental_analysis::incremental_analysis(uint32_t levels, scheme s, const std::vector<lifting_step>& custom_steps) : _n(0), _levels(levels),
+_steps(get_lifting_steps(s, custom_steps)), _samples(levels), _dirty{ 0, 0 }, _updated_n(0), _border(0)
+  {
+  if (levels == 0 || levels > 62)
+    throw std::runtime_error("invalid number of levels");
+  for (const auto& step : _steps)
+    {
+    if ((step.type == lst_scale_even || step.type == lst_scale_odd) && !step.mask.empty())
+      _border = std::max<uint64_t>(_border, (uint64_t)std::max<int64_t>(0, step.only_scale_away_from_border));
+    }
+  }
+
+incremental_analysis::incremental_analysis(const double* coefficients, uint64_t n, uint32_t levels, scheme s, const std::vector<lifting_step>& custom_steps) :
+incremental_analysis(levels, s, custom_steps)
+  {
+  if (!lifting::is_multiple_of_power_of_two(n, levels))
+    throw std::runtime_error("the number of samples must be a multiple of 2^levels");
+  _n = n;
+  _updated_n = n;
+  _coefficients.assign(coefficients, coefficients + n);
+  // the inverse of one level leaves the samples of that level at multiples of 2^level
+  std::vector<double> values(_coefficients);
+  for (uint32_t l = levels; l > 0; --l)
+    {
+    inverse(values.data(), n, l - 1, s, custom_steps);
+    if (l > 1)
+      {
+      _samples[l - 1].resize((size_t)(n >> (l - 1)));
+      for (uint64_t i = 0; i < (n >> (l - 1)); ++i)
+        _samples[l - 1][i] = values[i << (l - 1)];
+      }
+    }
+  _samples[0].swap(values);
+  }
+
+incremental_analysis::incremental_analysis(const pyramid_file& pyramid) :
+incremental_analysis(get_interleaved(pyramid).data(), pyramid.size(), pyramid.levels(), pyramid.header().s, pyramid.header().custom_steps)
+  {
+  }
+
+void incremental_analysis::set_samples(uint64_t first, const double* values, uint64_t count)
+  {
+  if (first + count > _n)
+    throw std::runtime_error("sample range out of range");
+  if (count == 0)
+    return;
+  std::copy(values, values + count, _samples[0].begin() + first);
+  add(_dirty, first, first + count);
+  }
+
+void incremental_analysis::append(const double* values, uint64_t count)
+  {
+  _tail.insert(_tail.end(), values, values + count);
+  const uint64_t block = (uint64_t)1 << _levels;
+  const uint64_t m = _tail.size() - _tail.size() % block;
+  if (m == 0)
+    return;
+  const uint64_t old_n = _n;
+  _n += m;
+  _samples[0].insert(_samples[0].end(), _tail.begin(), _tail.begin() + m);
+  _tail.erase(_tail.begin(), _tail.begin() + m);
+  for (uint32_t l = 1; l < _levels; ++l)
+    _samples[l].resize((size_t)(_n >> l), 0.0);
+  _coefficients.resize((size_t)_n, 0.0);
+  add(_dirty, old_n, _n);
+  }
+
+void incremental_analysis::update()
+  {
+  pair_range dirty = _dirty; // the changed samples of level l
+  _dirty = { 0, 0 };
+  std::vector<double> window;
+  for (uint32_t l = 0; l < _levels && !dirty.empty(); ++l)
+    {
+    const uint64_t nr_of_pairs = (_n >> l) / 2;
+    pair_range affected = { dirty.first / 2, (dirty.last + 1) / 2 };
+    if (_updated_n != _n)
+      {
+      // the pairs that saw the old right border: the predict and update steps clamp to it, which spreading
+      // the new pairs catches, but the scale steps skip the last pairs
+      const uint64_t old_pairs = (_updated_n >> l) / 2;
+      add(affected, old_pairs > _border ? old_pairs - _border : 0, nr_of_pairs);
+      }
+    for (const auto& step : _steps)
+      affected = spread(affected, step, nr_of_pairs);
+
+    pair_range input;
+    const auto ranges = forward_ranges(_steps, affected, nr_of_pairs, input);
+    window.assign(_samples[l].begin() + 2 * input.first, _samples[l].begin() + 2 * input.last);
+    forward_range(window.data(), _n >> l, 0, _steps, ranges, 2 * input.first);
+    for (uint64_t p = affected.first; p < affected.last; ++p)
+      {
+      const double even = window[2 * (p - input.first)];
+      if (l + 1 < _levels)
+        _samples[l + 1][p] = even;
+      else
+        _coefficients[p << _levels] = even;
+      _coefficients[((p << 1) + 1) << l] = window[2 * (p - input.first) + 1];
+      }
+    dirty = affected;
+    }
+  _updated_n = _n;
+  }
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "lifting_range.h"
+#include "model.h"
+#include "pyramid_file.h"
+
+#include <vector>
+#include <stdint.h>
+
+/*
+Incremental inverse transform.
+
+Keeps the coefficients in the interleaved layout of the lifting kernels, as left by 'levels' calls to forward,
+together with the coarse samples of every intermediate level of the inverse. Editing a coefficient marks it dirty;
+update() then re-runs the inverse steps only where the edits have an effect. Per level it tracks one dirty interval,
+widened by the reach of each step, so the cost is proportional to the touched support and not to n. The result is
+identical to a full inverse of the edited coefficients.
+*/
+class incremental_synthesis
+  {
+  public:
+    incremental_synthesis(uint64_t n, uint32_t levels, scheme s, const std::vector<lifting_step>& custom_steps);
+
+    // takes n coefficients and synthesizes the full signal
+    void reset(const double* coefficients);
+
+    double coefficient(uint64_t index) const { return _coefficients[index]; }
+    void set_coefficient(uint64_t index, double value);
+
+    // re-synthesizes the dirty parts and returns the range of samples of the signal that were recomputed
+    pair_range update();
+
+    const std::vector<double>& coefficients() const { return _coefficients; }
+    const std::vector<double>& signal() const { return _samples[0]; }
+    uint64_t size() const { return _n; }
+    uint32_t levels() const { return _levels; }
+
+  private:
+    uint64_t _n;
+    uint32_t _levels;
+    std::vector<lifting_step> _steps;
+    std::vector<double> _coefficients;
+    std::vector<std::vector<double>> _samples; // _samples[l] holds the n >> l samples of level l, _samples[0] is the signal
+    std::vector<pair_range> _dirty_details; // per level, in indices of the details of that level
+    pair_range _dirty_coarse;
+  };
+
+/*
+Incremental forward transform.
+
+Keeps the signal, the coarse samples of every intermediate level and the coefficients in the interleaved layout.
+Editing or appending samples marks them dirty; update() then recomputes only the coefficients whose dependency cones
+intersect the dirty samples, level by level. Appended samples are transformed once they complete a multiple of
+2^levels samples, until then they wait in a tail. The result is identical to a full forward transform of the signal.
+
+It starts empty or from an existing pyramid, such as a rolling archive, whose signal and intermediate levels are
+rebuilt once by a full inverse transform; the result then matches a full forward transform of the rebuilt signal,
+which may differ from the original signal by rounding. The recomputed cones read the samples of every level, so
+these are kept in memory next to the coefficients: about 2n doubles besides the n coefficients.
+*/
+class incremental_analysis
+  {
+  public:
+    incremental_analysis(uint32_t levels, scheme s, const std::vector<lifting_step>& custom_steps);
+    // starts from the n coefficients of a signal of n samples in the interleaved layout, n a multiple of 2^levels
+    incremental_analysis(const double* coefficients, uint64_t n, uint32_t levels, scheme s, const std::vector<lifting_step>& custom_steps);
+    explicit incremental_analysis(const pyramid_file& pyramid);
+
+    // replaces samples [first, first + count), which must already be transformed
+    void set_samples(uint64_t first, const double* values, uint64_t count);
+    void append(const double* values, uint64_t count);
+
+    // recomputes the coefficients that depend on the dirty samples
+    void update();
+
+    // the transformed part of the signal and its coefficients, the samples in the tail are not included
+    const std::vector<double>& signal() const { return _samples[0]; }
+    const std::vector<double>& coefficients() const { return _coefficients; }
+    uint64_t size() const { return _n; }
+    uint64_t tail_size() const { return _tail.size(); }
+    uint32_t levels() const { return _levels; }
+
+  private:
+    uint64_t _n;
+    uint32_t _levels;
+    std::vector<lifting_step> _steps;
+    std::vector<double> _coefficients;
+    std::vector<std::vector<double>> _samples; // _samples[l] holds the n >> l samples of level l, _samples[0] is the signal
+    std::vector<double> _tail;
+    pair_range _dirty; // in samples of the signal
+    uint64_t _updated_n; // the size at the last update
+    uint64_t _border; // the number of pairs at the border that the scale steps skip
+  };
@@ -0,0 +1,109 @@
+#include "lifting_range.h"
+
+#include "../lifting/lifting.h"
+
+#include <algorithm>
+#include <cassert>
+
+void get_reach(const lifting_step& step, int64_t& left, int64_t& right)
+  {
+  switch (step.type)
+    {
+    case lst_predict: lifting::predict_reach(step.mask.size(), left, right); break;
+    case lst_update: lifting::update_reach(step.mask.size(), left, right); break;
+    default: left = 0; right = 0; break;
+    }
+  }
+
+pair_range expand(const pair_range& r, const lifting_step& step, uint64_t nr_of_pairs)
+  {
+  if (r.empty())
+    return r;
+  int64_t left, right;
+  get_reach(step, left, right);
+  pair_range result;
+  result.first = r.first > (uint64_t)left ? r.first - (uint64_t)left : 0;
+  result.last = std::min<uint64_t>(nr_of_pairs, r.last + (uint64_t)right);
+  return result;
+  }
+
+pair_range spread(const pair_range& r, const lifting_step& step, uint64_t nr_of_pairs)
+  {
+  if (r.empty())
+    return r;
+  int64_t left, right;
+  get_reach(step, left, right);
+  pair_range result;
+  result.first = r.first > (uint64_t)right ? r.first - (uint64_t)right : 0;
+  result.last = std::min<uint64_t>(nr_of_pairs, r.last + (uint64_t)left);
+  return result;
+  }
+
+std::vector<pair_range> forward_ranges(const std::vector<lifting_step>& steps, const pair_range& target, uint64_t nr_of_pairs, pair_range& input)
+  {
+  std::vector<pair_range> ranges(steps.size());
+  pair_range r = target;
+  r.last = std::min<uint64_t>(r.last, nr_of_pairs);
+  for (size_t k = steps.size(); k > 0; --k)
+    {
+    ranges[k - 1] = r;
+    r = expand(r, steps[k - 1], nr_of_pairs);
+    }
+  input = r;
+  return ranges;
+  }
+
+std::vector<pair_range> inverse_ranges(const std::vector<lifting_step>& steps, const pair_range& target, uint64_t nr_of_pairs, pair_range& input)
+  {
+  std::vector<pair_range> ranges(steps.size());
+  pair_range r = target;
+  r.last = std::min<uint64_t>(r.last, nr_of_pairs);
+  // the inverse executes the last step first, so ranges[k] belongs to steps[steps.size() - 1 - k]
+  for (size_t k = 0; k < steps.size(); ++k)
+    {
+    ranges[steps.size() - 1 - k] = r;
+    r = expand(r, steps[k], nr_of_pairs);
+    }
+  input = r;
+  return ranges;
+  }
+
+void forward_range(double* sample, uint64_t n, uint64_t level, const std::vector<lifting_step>& steps, const std::vector<pair_range>& ranges, uint64_t sample_offset, uint64_t stride)
+  {
+  using namespace lifting;
+  assert(ranges.size() == steps.size());
+  for (size_t k = 0; k < steps.size(); ++k)
+    {
+    const lifting_step& s = steps[k];
+    const pair_range& r = ranges[k];
+    if (r.empty())
+      continue;
+    switch (s.type)
+      {
+      case lst_predict: predict_range(sample, n, s.mask, level, stride, false, r.first, r.last, sample_offset); break;
+      case lst_update: update_range(sample, n, s.mask, level, stride, false, r.first, r.last, sample_offset); break;
+      case lst_scale_even: if (!s.mask.empty()) scale_even_range(sample, n, s.mask.front(), level, s.only_scale_away_from_border, stride, false, r.first, r.last, sample_offset); break;
+      case lst_scale_odd: if (!s.mask.empty()) scale_odd_range(sample, n, s.mask.front(), level, s.only_scale_away_from_border, stride, false, r.first, r.last, sample_offset); break;
+      }
+    }
+  }
+
+void inverse_range(double* sample, uint64_t n, uint64_t level, const std::vector<lifting_step>& steps, const std::vector<pair_range>& ranges, uint64_t sample_offset, uint64_t stride)
+  {
+  using namespace lifting;
+  assert(ranges.size() == steps.size());
+  for (size_t k = 0; k < steps.size(); ++k)
+    {
+    const lifting_step& s = steps[steps.size() - 1 - k];
+    const pair_range& r = ranges[k];
+    if (r.empty())
+      continue;
+    switch (s.type)
+      {
+      case lst_predict: ipredict_range(sample, n, s.mask, level, stride, false, r.first, r.last, sample_offset); break;
+      case lst_update: iupdate_range(sample, n, s.mask, level, stride, false, r.first, r.last, sample_offset); break;
+      case lst_scale_even: if (!s.mask.empty()) iscale_even_range(sample, n, s.mask.front(), level, s.only_scale_away_from_border, stride, false, r.first, r.last, sample_offset); break;
+      case lst_scale_odd: if (!s.mask.empty()) iscale_odd_range(sample, n, s.mask.front(), level, s.only_scale_away_from_border, stride, false, r.first, r.last, sample_offset); break;
+      }
+    }
+  }
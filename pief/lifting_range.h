@@ -0,0 +1,45 @@
+#pragma once
+
+#include "model.h"
+
+#include <vector>
+#include <stdint.h>
+
+/*
+Helpers to lift only part of a level.
+
+A level of n samples consists of n/2 pairs (even sample 2i, odd sample 2i+1 at that level). Every lifting step
+reads a few neighbouring pairs, so to obtain a range of exact pairs after all steps of a level, each earlier step
+has to be executed over a slightly wider range: the dependency cone. These helpers compute that cone and run the
+steps over it, with the borders of the full signal (non cyclical).
+*/
+
+struct pair_range
+  {
+  uint64_t first;
+  uint64_t last;
+
+  bool empty() const { return last <= first; }
+  };
+
+// a step lifts pair i with pairs [i - left, i + right]
+void get_reach(const lifting_step& step, int64_t& left, int64_t& right);
+
+// the pairs that have to be exact before 'step' so that the pairs in r are exact after it
+pair_range expand(const pair_range& r, const lifting_step& step, uint64_t nr_of_pairs);
+
+// the pairs whose result after 'step' changes when the pairs in r change before it
+pair_range spread(const pair_range& r, const lifting_step& step, uint64_t nr_of_pairs);
+
+/*
+Returns the range of pairs to lift for each step, in the order in which forward_range (or inverse_range) executes the steps,
+so that the pairs in 'target' are exact at the end. 'input' receives the pairs that have to be exact before the first step.
+*/
+std::vector<pair_range> forward_ranges(const std::vector<lifting_step>& steps, const pair_range& target, uint64_t nr_of_pairs, pair_range& input);
+std::vector<pair_range> inverse_ranges(const std::vector<lifting_step>& steps, const pair_range& target, uint64_t nr_of_pairs, pair_range& input);
+
+/*
+Runs the steps of one level only over the given ranges. 'sample' holds the samples of the level from position sample_offset on.
+*/
+void forward_range(double* sample, uint64_t n, uint64_t level, const std::vector<lifting_step>& steps, const std::vector<pair_range>& ranges, uint64_t sample_offset = 0, uint64_t stride = 1);
+void inverse_range(double* sample, uint64_t n, uint64_t level, const std::vector<lifting_step>& steps, const std::vector<pair_range>& ranges, uint64_t sample_offset = 0, uint64_t stride = 1);
@@ -1,25 +1,8 @@
 #pragma once
 
-#include "imgui.h"
-
+#include <mutex>
 #include <sstream>
 
-class AppLog
-  {
-  public:
-    void Clear();
-    void AddLog(const char* fmt, ...) IM_FMTARGS(2);
-    void Draw(const char* title, bool* p_open = NULL);
-
-  private:
-    ImGuiTextBuffer     Buf;
-    ImGuiTextFilter     Filter;
-    ImVector<int>       LineOffsets;        // Index to lines offset
-    bool                ScrollToBottom;
-  };
-
-
-
 class Logging
   {
   public:
@@ -35,15 +18,18 @@ class Logging
     template <class T>
     Logging& operator << (const T& t)
       {
+      std::lock_guard<std::mutex> lock(_mutex);
       _os << t;
       return *this;
       }
 
     std::string pop_messages();
+    bool has_messages();
 
   private:
     Logging();
 
   private:
     std::ostringstream _os;
+    std::mutex _mutex; // messages also come from the worker threads
   };
\ No newline at end of file
@@ -0,0 +1,212 @@
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+mapped_file::mapped_file() : _data(nullptr), _size(0), _mode(READ), _handle_open(false)
+#if defined(_WIN32)
+, _file(nullptr), _mapping(nullptr)
+#else
+, _fd(-1)
+#endif
+  {
+  }
+
+mapped_file::mapped_file(const std::string& filename, mode m, uint64_t size) : mapped_file()
+  {
+  open(filename, m, size);
+  }
+
+mapped_file::~mapped_file()
+  {
+  close();
+  }
+
+mapped_file::mapped_file(mapped_file&& other) noexcept : mapped_file()
+  {
+  *this = std::move(other);
+  }
+
+mapped_file& mapped_file::operator = (mapped_file&& other) noexcept
+  {
+  if (this != &other)
+    {
+    close();
+    std::swap(_data, other._data);
+    std::swap(_size, other._size);
+    std::swap(_mode, other._mode);
+    std::swap(_handle_open, other._handle_open);
+#if defined(_WIN32)
+    std::swap(_file, other._file);
+    std::swap(_mapping, other._mapping);
+#else
+    std::swap(_fd, other._fd);
+#endif
+    }
+  return *this;
+  }
+
+#if defined(_WIN32)
+
+void mapped_file::open(const std::string& filename, mode m, uint64_t size)
+  {
+  close();
+  const DWORD access = m == READ ? GENERIC_READ : (GENERIC_READ | GENERIC_WRITE);
+  const DWORD creation = m == CREATE ? CREATE_ALWAYS : OPEN_EXISTING;
+  HANDLE file = CreateFileA(filename.c_str(), access, FILE_SHARE_READ, NULL, creation, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE)
+    throw std::runtime_error("cannot open " + filename);
+  if (m == CREATE)
+    {
+    LARGE_INTEGER sz;
+    sz.QuadPart = (LONGLONG)size;
+    if (!SetFilePointerEx(file, sz, NULL, FILE_BEGIN) || !SetEndOfFile(file))
+      {
+      CloseHandle(file);
+      throw std::runtime_error("cannot resize " + filename);
+      }
+    }
+  else
+    {
+    LARGE_INTEGER sz;
+    GetFileSizeEx(file, &sz);
+    size = (uint64_t)sz.QuadPart;
+    }
+  _file = file;
+  _mode = m;
+  _size = size;
+  _handle_open = true;
+  if (size == 0)
+    return;
+  _mapping = CreateFileMappingA(file, NULL, m == READ ? PAGE_READONLY : PAGE_READWRITE, (DWORD)(size >> 32), (DWORD)(size & 0xffffffff), NULL);
+  if (_mapping)
+    _data = (char*)MapViewOfFile(_mapping, m == READ ? FILE_MAP_READ : FILE_MAP_WRITE, 0, 0, (SIZE_T)size);
+  if (!_data)
+    {
+    close();
+    throw std::runtime_error("cannot map " + filename);
+    }
+  }
+
+void mapped_file::close()
+  {
+  if (_data)
+    UnmapViewOfFile(_data);
+  if (_mapping)
+    CloseHandle(_mapping);
+  if (_file)
+    CloseHandle(_file);
+  _data = nullptr;
+  _mapping = nullptr;
+  _file = nullptr;
+  _size = 0;
+  _handle_open = false;
+  }
+
+void mapped_file::flush()
+  {
+  if (_data && _mode != READ)
+    FlushViewOfFile(_data, 0);
+  }
+
+void mapped_file::will_need(uint64_t offset, uint64_t length) const
+  {
+  if (!_data || offset >= _size)
+    return;
+  WIN32_MEMORY_RANGE_ENTRY range;
+  range.VirtualAddress = _data + offset;
+  range.NumberOfBytes = (SIZE_T)std::min<uint64_t>(length, _size - offset);
+  PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+  }
+
+void mapped_file::sequential() const
+  {
+  }
+
+#else
+
+void mapped_file::open(const std::string& filename, mode m, uint64_t size)
+  {
+  close();
+  const int flags = m == READ ? O_RDONLY : (m == WRITE ? O_RDWR : (O_RDWR | O_CREAT | O_TRUNC));
+  int fd = ::open(filename.c_str(), flags, 0644);
+  if (fd < 0)
+    throw std::runtime_error("cannot open " + filename);
+  if (m == CREATE)
+    {
+    if (ftruncate(fd, (off_t)size) != 0)
+      {
+      ::close(fd);
+      throw std::runtime_error("cannot resize " + filename);
+      }
+    }
+  else
+    {
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+      {
+      ::close(fd);
+      throw std::runtime_error("cannot stat " + filename);
+      }
+    size = (uint64_t)st.st_size;
+    }
+  _fd = fd;
+  _mode = m;
+  _size = size;
+  _handle_open = true;
+  if (size == 0)
+    return;
+  void* p = mmap(nullptr, (size_t)size, m == READ ? PROT_READ : (PROT_READ | PROT_WRITE), MAP_SHARED, fd, 0);
+  if (p == MAP_FAILED)
+    {
+    close();
+    throw std::runtime_error("cannot map " + filename);
+    }
+  _data = (char*)p;
+  }
+
+void mapped_file::close()
+  {
+  if (_data)
+    munmap(_data, (size_t)_size);
+  if (_fd >= 0)
+    ::close(_fd);
+  _data = nullptr;
+  _fd = -1;
+  _size = 0;
+  _handle_open = false;
+  }
+
+void mapped_file::flush()
+  {
+  if (_data && _mode != READ)
+    msync(_data, (size_t)_size, MS_SYNC);
+  }
+
+void mapped_file::will_need(uint64_t offset, uint64_t length) const
+  {
+  if (!_data || offset >= _size)
+    return;
+  const uint64_t page = (uint64_t)sysconf(_SC_PAGESIZE);
+  const uint64_t first = offset & ~(page - 1);
+  const uint64_t last = offset + length < _size ? offset + length : _size;
+  madvise(_data + first, (size_t)(last - first), MADV_WILLNEED);
+  }
+
+void mapped_file::sequential() const
+  {
+  if (_data)
+    madvise(_data, (size_t)_size, MADV_SEQUENTIAL);
+  }
+
+#endif
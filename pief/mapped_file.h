@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+#include <stdint.h>
+
+/*
+Memory mapping of a file. Pages are only read from disk when they are touched.
+*/
+class mapped_file
+  {
+  public:
+    enum mode
+      {
+      READ,
+      WRITE, // maps an existing file for reading and writing
+      CREATE // creates or truncates the file to 'size' bytes and maps it for reading and writing
+      };
+
+    mapped_file();
+    mapped_file(const std::string& filename, mode m, uint64_t size = 0);
+    ~mapped_file();
+
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator = (const mapped_file&) = delete;
+    mapped_file(mapped_file&& other) noexcept;
+    mapped_file& operator = (mapped_file&& other) noexcept;
+
+    void open(const std::string& filename, mode m, uint64_t size = 0);
+    void close();
+
+    // writes dirty pages back to the file
+    void flush();
+
+    // hints the kernel that [offset, offset + length) will be read soon or sequentially
+    void will_need(uint64_t offset, uint64_t length) const;
+    void sequential() const;
+
+    bool is_open() const { return _handle_open; }
+    char* data() { return _data; }
+    const char* data() const { return _data; }
+    uint64_t size() const { return _size; }
+    bool writable() const { return _mode != READ; }
+
+  private:
+    char* _data;
+    uint64_t _size;
+    mode _mode;
+    bool _handle_open;
+#if defined(_WIN32)
+    void* _file;
+    void* _mapping;
+#else
+    int _fd;
+#endif
+  };
@@ -1,47 +1,55 @@
 #include "model.h"
 #include "logging.h"
 
-#include <glew/GL/glew.h>
-#include "jtk/jtk/opengl.h"
-
+#include "parallel.h"
 #include "parse.h"
+#include "sparse.h"
 
 #include "../lifting/lifting.h"
 #include "../lifting/sobolev.h"
 
 #include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <list>
+#include <mutex>
 #include <sstream>
+#include <stdexcept>
 #include <numeric>
 
 namespace
   {
 
-  void forward_custom(double* sample, uint64_t n, uint64_t level, const std::vector<lifting_step>& custom_steps)
+  template <class T>
+  void forward_custom(T* sample, uint64_t n, uint64_t level, const std::vector<lifting_step>& custom_steps, uint64_t stride = 1, bool cyclical = false)
     {
     using namespace lifting;
     for (const auto& s : custom_steps)
       {
       switch (s.type)
         {
-        case lst_predict: predict(sample, n, s.mask, level, 1, false); break;
-        case lst_update: update(sample, n, s.mask, level, 1, false); break;
-        case lst_scale_even: if (!s.mask.empty()) scale_even(sample, n, s.mask.front(), level, 1, 1, false); break;
-        case lst_scale_odd:  if (!s.mask.empty()) scale_odd(sample, n, s.mask.front(), level, 1, 1, false); break;
+        case lst_predict: predict(sample, n, s.mask, level, stride, cyclical); break;
+        case lst_update: update(sample, n, s.mask, level, stride, cyclical); break;
+        case lst_scale_even: if (!s.mask.empty()) scale_even(sample, n, s.mask.front(), level, s.only_scale_away_from_border, stride, cyclical); break;
+        case lst_scale_odd:  if (!s.mask.empty()) scale_odd(sample, n, s.mask.front(), level, s.only_scale_away_from_border, stride, cyclical); break;
         }
       }
     }
 
-  void inverse_custom(double* sample, uint64_t n, uint64_t level, const std::vector<lifting_step>& custom_steps)
+  template <class T>
+  void inverse_custom(T* sample, uint64_t n, uint64_t level, const std::vector<lifting_step>& custom_steps, uint64_t stride = 1, bool cyclical = false)
     {
     using namespace lifting;
     for (auto rit = custom_steps.rbegin(); rit != custom_steps.rend(); ++rit)
       {
       switch (rit->type)
         {
-        case lst_predict: ipredict(sample, n, rit->mask, level, 1, false); break;
-        case lst_update: iupdate(sample, n, rit->mask, level, 1, false); break;
-        case lst_scale_even: if (!rit->mask.empty()) iscale_even(sample, n, rit->mask.front(), level, 1, 1, false); break;
-        case lst_scale_odd: if (!rit->mask.empty()) iscale_odd(sample, n, rit->mask.front(), level, 1, 1, false); break;
+        case lst_predict: ipredict(sample, n, rit->mask, level, stride, cyclical); break;
+        case lst_update: iupdate(sample, n, rit->mask, level, stride, cyclical); break;
+        case lst_scale_even: if (!rit->mask.empty()) iscale_even(sample, n, rit->mask.front(), level, rit->only_scale_away_from_border, stride, cyclical); break;
+        case lst_scale_odd: if (!rit->mask.empty()) iscale_odd(sample, n, rit->mask.front(), level, rit->only_scale_away_from_border, stride, cyclical); break;
         }
       }
     }
@@ -98,30 +106,9 @@ namespace
 
   }
 
-model::model() : levels(12), _vao(nullptr), _vbo_array(nullptr)
-  {
-
-  }
-
-model::~model()
+model::model() : levels(12)
   {
-  delete_render_objects();
-  }
 
-void model::delete_render_objects()
-  {
-  if (_vao)
-    {
-    _vao->release();
-    delete _vao;
-    _vao = nullptr;
-    }
-  if (_vbo_array)
-    {
-    _vbo_array->release();
-    delete _vbo_array;
-    _vbo_array = nullptr;
-    }
   }
 
 void biorthogonal_inverse(double* sample, uint64_t n, uint64_t level, scheme s, const std::vector<lifting_step>& custom_steps)
@@ -199,169 +186,376 @@ void biorthogonal_inverse(double* sample, uint64_t n, uint64_t level, scheme s,
     };
   }
 
-void make_scaling_function(model& m, scheme s, const std::vector<lifting_step>& custom_steps)
+namespace
   {
-  uint64_t n = ((uint64_t)1 << (uint64_t)m.levels);
-  m.values.resize(n);
-  for (auto& v : m.values)
-    v = 0.0;
-  m.values[n / 2] = 1.0;
+  void add_step(std::vector<lifting_step>& steps, lifting_step_type type, const std::vector<double>& mask)
+    {
+    steps.emplace_back();
+    steps.back().type = type;
+    steps.back().mask = mask;
+    }
+
+  void add_scale_step(std::vector<lifting_step>& steps, lifting_step_type type, double s, int64_t only_scale_away_from_border)
+    {
+    steps.emplace_back();
+    steps.back().type = type;
+    steps.back().mask.push_back(s);
+    steps.back().only_scale_away_from_border = only_scale_away_from_border;
+    }
+  }
+
+std::vector<lifting_step> get_lifting_steps(scheme s, const std::vector<lifting_step>& custom_steps)
+  {
+  using namespace lifting;
+  std::vector<lifting_step> steps;
   switch (s)
     {
     case jamlet_linear:
-      for (int lev = m.levels - get_width(s); lev >= 0; --lev)
-        lifting::inverse_jamlet_linear(m.values.data(), n, lev);
+      add_step(steps, lst_predict, get_prediction_mask_jamlet_linear());
+      add_step(steps, lst_update, get_update_mask_jamlet_linear());
       break;
     case jamlet_quadratic:
-      for (int lev = m.levels - get_width(s); lev >= 0; --lev)
-        lifting::inverse_jamlet_quadratic(m.values.data(), n, lev);
+      add_step(steps, lst_update, get_first_update_mask_jamlet_quadratic());
+      add_scale_step(steps, lst_scale_even, get_even_scaling_factor_jamlet_quadratic(), 1);
+      add_step(steps, lst_predict, get_prediction_mask_jamlet_quadratic());
+      add_step(steps, lst_update, get_second_update_mask_jamlet_quadratic());
       break;
     case jamlet_cubic:
-      for (int lev = m.levels - get_width(s); lev >= 0; --lev)
-        lifting::inverse_jamlet_cubic(m.values.data(), n, lev);
+      add_scale_step(steps, lst_scale_even, get_even_scaling_factor_jamlet_cubic(), 1);
+      add_step(steps, lst_update, get_first_update_mask_jamlet_cubic());
+      add_step(steps, lst_predict, get_prediction_mask_jamlet_cubic());
+      add_step(steps, lst_update, get_second_update_mask_jamlet_cubic());
       break;
     case jamlet_4_point:
-      for (int lev = m.levels - get_width(s); lev >= 0; --lev)
-        lifting::inverse_jamlet_4_point(m.values.data(), n, lev);
+      add_step(steps, lst_predict, get_prediction_mask_jamlet_4_point());
+      add_step(steps, lst_update, get_update_mask_jamlet_4_point());
       break;
     case cdf_5_3:
-      for (int lev = m.levels - get_width(s); lev >= 0; --lev)
-        lifting::inverse_cdf_5_3(m.values.data(), n, lev);
+      add_step(steps, lst_predict, get_prediction_mask_cdf_5_3());
+      add_step(steps, lst_update, get_update_mask_cdf_5_3());
       break;
     case cdf_9_7:
-      for (int lev = m.levels - get_width(s); lev >= 0; --lev)
-        lifting::inverse_cdf_9_7(m.values.data(), n, lev);
+      add_step(steps, lst_predict, get_first_prediction_mask_cdf_9_7());
+      add_step(steps, lst_update, get_first_update_mask_cdf_9_7());
+      add_step(steps, lst_predict, get_second_prediction_mask_cdf_9_7());
+      add_step(steps, lst_update, get_second_update_mask_cdf_9_7());
+      add_scale_step(steps, lst_scale_odd, get_odd_scaling_factor_cdf_9_7(), 0);
+      add_scale_step(steps, lst_scale_even, get_even_scaling_factor_cdf_9_7(), 0);
       break;
     case chaikin:
-      for (int lev = m.levels - get_width(s); lev >= 0; --lev)
-        lifting::inverse_chaikin(m.values.data(), n, lev);
+      add_step(steps, lst_update, get_update_mask_chaikin());
+      add_scale_step(steps, lst_scale_even, get_even_scaling_factor_chaikin(), 1);
+      add_step(steps, lst_predict, get_prediction_mask_chaikin());
+      add_step(steps, lst_update, get_second_update_mask_chaikin());
       break;
     case cubic_bsplines:
-      for (int lev = m.levels - get_width(s); lev >= 0; --lev)
-        lifting::inverse_cubic_bsplines(m.values.data(), n, lev);
+      add_step(steps, lst_update, get_update_mask_cubic_bsplines());
+      add_scale_step(steps, lst_scale_even, get_even_scaling_factor_cubic_bsplines(), 1);
+      add_step(steps, lst_predict, get_prediction_mask_cubic_bsplines());
       break;
     case cubic_bspline_wavelets:
-      for (int lev = m.levels - get_width(s); lev >= 0; --lev)
-        lifting::inverse_cubic_bspline_wavelets(m.values.data(), n, lev);
+      add_scale_step(steps, lst_scale_even, get_even_scaling_factor_cubic_bspline_wavelets(), 1);
+      add_step(steps, lst_update, get_first_update_mask_cubic_bspline_wavelets());
+      add_step(steps, lst_predict, get_prediction_mask_cubic_bspline_wavelets());
+      add_step(steps, lst_update, get_second_update_mask_cubic_bspline_wavelets());
       break;
     case daubechies_d4:
-      for (int lev = m.levels - get_width(s); lev >= 0; --lev)
-        lifting::inverse_daubechies_d4(m.values.data(), n, lev);
+      add_step(steps, lst_update, get_first_update_mask_daubechies_d4());
+      add_step(steps, lst_predict, get_prediction_mask_daubechies_d4());
+      add_step(steps, lst_update, get_second_update_mask_daubechies_d4());
+      add_scale_step(steps, lst_scale_even, get_even_scaling_factor_daubechies_d4(), 0);
+      add_scale_step(steps, lst_scale_odd, get_odd_scaling_factor_daubechies_d4(), 0);
       break;
     case four_point:
-      for (int lev = m.levels - get_width(s); lev >= 0; --lev)
-        lifting::inverse_4_point(m.values.data(), n, lev);
+      add_step(steps, lst_predict, get_prediction_mask_4_point());
+      add_step(steps, lst_update, get_update_mask_4_point());
       break;
     case haar:
-      for (int lev = m.levels - get_width(s); lev >= 0; --lev)
-        lifting::inverse_haar(m.values.data(), n, lev);
+      add_step(steps, lst_predict, get_prediction_mask_haar());
+      add_step(steps, lst_update, get_update_mask_haar());
       break;
     case custom:
-      for (int lev = m.levels - get_width(s); lev >= 0; --lev)
-        inverse_custom(m.values.data(), n, lev, custom_steps);
+      steps = custom_steps;
       break;
-    };
+    }
+  return steps;
   }
 
-void make_wavelet_function(model& m, scheme s, const std::vector<lifting_step>& custom_steps)
+std::vector<lifting_step> get_dual_lifting_steps(scheme s, const std::vector<lifting_step>& custom_steps)
   {
-  uint64_t n = ((uint64_t)1 << (uint64_t)m.levels);
-  m.values.resize(n);
-  for (auto& v : m.values)
-    v = 0.0;
-  m.values[n / 2 + ((uint64_t)1 << (uint64_t)(m.levels - get_width(s)))] = 1.0;
+  // predict and update swap roles, the scale factors are inverted and the scale steps keep away from the border
+  std::vector<lifting_step> steps = get_lifting_steps(s, custom_steps);
+  for (auto& step : steps)
+    {
+    switch (step.type)
+      {
+      case lst_predict: step.type = lst_update; break;
+      case lst_update: step.type = lst_predict; break;
+      case lst_scale_even:
+      case lst_scale_odd:
+        if (!step.mask.empty())
+          step.mask.front() = 1.0 / step.mask.front();
+        step.only_scale_away_from_border = 1;
+        break;
+      }
+    }
+  return steps;
+  }
+
+scheme scheme_from_name(const std::string& name)
+  {
+  const char* names[] = { "jamlet_linear", "jamlet_quadratic", "jamlet_cubic", "jamlet_4_point", "cdf_5_3", "cdf_9_7", "chaikin", "cubic_bsplines", "cubic_bspline_wavelets", "daubechies_d4", "four_point", "haar" };
+  static_assert(sizeof(names) / sizeof(names[0]) == (size_t)custom, "a scheme without a name");
+  for (int k = 0; k < (int)custom; ++k)
+    {
+    if (name == names[k])
+      return (scheme)k;
+    }
+  throw std::runtime_error("unknown scheme " + name);
+  }
+
+uint32_t default_levels(uint64_t n)
+  {
+  uint32_t levels = 0;
+  while (levels < max_default_levels && lifting::is_multiple_of_power_of_two(n, levels + 1) && (n >> (levels + 1)) > 0)
+    ++levels;
+  return levels;
+  }
+
+template <class T>
+void forward(T* sample, uint64_t n, uint64_t level, scheme s, const std::vector<lifting_step>& custom_steps, uint64_t stride, bool cyclical)
+  {
+  using namespace lifting;
   switch (s)
     {
-    case jamlet_linear:
+    case jamlet_linear: forward_jamlet_linear(sample, n, level, stride, cyclical); break;
+    case jamlet_quadratic: forward_jamlet_quadratic(sample, n, level, stride, cyclical); break;
+    case jamlet_cubic: forward_jamlet_cubic(sample, n, level, stride, cyclical); break;
+    case jamlet_4_point: forward_jamlet_4_point(sample, n, level, stride, cyclical); break;
+    case cdf_5_3: forward_cdf_5_3(sample, n, level, stride, cyclical); break;
+    case cdf_9_7: forward_cdf_9_7(sample, n, level, stride, cyclical); break;
+    case chaikin: forward_chaikin(sample, n, level, stride, cyclical); break;
+    case cubic_bsplines: forward_cubic_bsplines(sample, n, level, stride, cyclical); break;
+    case cubic_bspline_wavelets: forward_cubic_bspline_wavelets(sample, n, level, stride, cyclical); break;
+    case daubechies_d4: forward_daubechies_d4(sample, n, level, stride, cyclical); break;
+    case four_point: forward_4_point(sample, n, level, stride, cyclical); break;
+    case haar: forward_haar(sample, n, level, stride, cyclical); break;
+    case custom: forward_custom(sample, n, level, custom_steps, stride, cyclical); break;
+    }
+  }
 
-      for (int lev = m.levels - get_width(s); lev >= 0; --lev)
-        lifting::inverse_jamlet_linear(m.values.data(), n, lev);
-      break;
-    case jamlet_quadratic:
-      for (int lev = m.levels - get_width(s); lev >= 0; --lev)
-        lifting::inverse_jamlet_quadratic(m.values.data(), n, lev);
-      break;
-    case jamlet_cubic:
-      for (int lev = m.levels - get_width(s); lev >= 0; --lev)
-        lifting::inverse_jamlet_cubic(m.values.data(), n, lev);
-      break;
-    case jamlet_4_point:
-      for (int lev = m.levels - get_width(s); lev >= 0; --lev)
-        lifting::inverse_jamlet_4_point(m.values.data(), n, lev);
-      break;
-    case cdf_5_3:
-      for (int lev = m.levels - get_width(s); lev >= 0; --lev)
-        lifting::inverse_cdf_5_3(m.values.data(), n, lev);
-      break;
-    case cdf_9_7:
-      for (int lev = m.levels - get_width(s); lev >= 0; --lev)
-        lifting::inverse_cdf_9_7(m.values.data(), n, lev);
-      break;
-    case chaikin:
-      for (int lev = m.levels - get_width(s); lev >= 0; --lev)
-        lifting::inverse_chaikin(m.values.data(), n, lev);
-      break;
-    case cubic_bsplines:
-      for (int lev = m.levels - get_width(s); lev >= 0; --lev)
-        lifting::inverse_cubic_bsplines(m.values.data(), n, lev);
-      break;
-    case cubic_bspline_wavelets:
-      for (int lev = m.levels - get_width(s); lev >= 0; --lev)
-        lifting::inverse_cubic_bspline_wavelets(m.values.data(), n, lev);
-      break;
-    case daubechies_d4:
-      for (int lev = m.levels - get_width(s); lev >= 0; --lev)
-        lifting::inverse_daubechies_d4(m.values.data(), n, lev);
-      break;
-    case four_point:
-      for (int lev = m.levels - get_width(s); lev >= 0; --lev)
-        lifting::inverse_4_point(m.values.data(), n, lev);
-      break;
-    case haar:
-      for (int lev = m.levels - get_width(s); lev >= 0; --lev)
-        lifting::inverse_haar(m.values.data(), n, lev);
-      break;
-    case custom:
-      for (int lev = m.levels - get_width(s); lev >= 0; --lev)
-        inverse_custom(m.values.data(), n, lev, custom_steps);
-      break;
+template <class T>
+void inverse(T* sample, uint64_t n, uint64_t level, scheme s, const std::vector<lifting_step>& custom_steps, uint64_t stride, bool cyclical)
+  {
+  using namespace lifting;
+  switch (s)
+    {
+    case jamlet_linear: inverse_jamlet_linear(sample, n, level, stride, cyclical); break;
+    case jamlet_quadratic: inverse_jamlet_quadratic(sample, n, level, stride, cyclical); break;
+    case jamlet_cubic: inverse_jamlet_cubic(sample, n, level, stride, cyclical); break;
+    case jamlet_4_point: inverse_jamlet_4_point(sample, n, level, stride, cyclical); break;
+    case cdf_5_3: inverse_cdf_5_3(sample, n, level, stride, cyclical); break;
+    case cdf_9_7: inverse_cdf_9_7(sample, n, level, stride, cyclical); break;
+    case chaikin: inverse_chaikin(sample, n, level, stride, cyclical); break;
+    case cubic_bsplines: inverse_cubic_bsplines(sample, n, level, stride, cyclical); break;
+    case cubic_bspline_wavelets: inverse_cubic_bspline_wavelets(sample, n, level, stride, cyclical); break;
+    case daubechies_d4: inverse_daubechies_d4(sample, n, level, stride, cyclical); break;
+    case four_point: inverse_4_point(sample, n, level, stride, cyclical); break;
+    case haar: inverse_haar(sample, n, level, stride, cyclical); break;
+    case custom: inverse_custom(sample, n, level, custom_steps, stride, cyclical); break;
+    }
+  }
+
+template void forward<double>(double*, uint64_t, uint64_t, scheme, const std::vector<lifting_step>&, uint64_t, bool);
+template void forward<float>(float*, uint64_t, uint64_t, scheme, const std::vector<lifting_step>&, uint64_t, bool);
+template void inverse<double>(double*, uint64_t, uint64_t, scheme, const std::vector<lifting_step>&, uint64_t, bool);
+template void inverse<float>(float*, uint64_t, uint64_t, scheme, const std::vector<lifting_step>&, uint64_t, bool);
+
+namespace
+  {
+  enum basis_function_type
+    {
+    bft_scaling,
+    bft_wavelet,
+    bft_biorthogonal_scaling,
+    bft_biorthogonal_wavelet
     };
+
+  struct basis_function
+    {
+    basis_function_type type;
+    int levels;
+    scheme s;
+    std::vector<lifting_step> custom_steps;
+    uint64_t first;
+    std::vector<double> values; // the samples [first, first + values.size()), the others are zero
+    };
+
+  const size_t max_cached_basis_functions = 64;
+  std::mutex basis_function_mutex;
+  std::list<basis_function> basis_function_cache; // most recently used first
+
+  bool equal_steps(const std::vector<lifting_step>& a, const std::vector<lifting_step>& b)
+    {
+    if (a.size() != b.size())
+      return false;
+    for (size_t i = 0; i < a.size(); ++i)
+      {
+      if (a[i].type != b[i].type || a[i].mask != b[i].mask || a[i].only_scale_away_from_border != b[i].only_scale_away_from_border)
+        return false;
+      }
+    return true;
+    }
+
+  /*
+  A basis function is the inverse of a single coefficient: n / 2 for the scaling function, n / 2 + 2^(levels - width)
+  for the wavelet. Only its support is lifted (see impulse_response), and the result is cached, so that switching
+  between the functions or changing the number of levels only costs the copy into m.values.
+  */
+  void make_basis_function(model& m, basis_function_type type, scheme s, const std::vector<lifting_step>& custom_steps)
+    {
+    const uint64_t n = ((uint64_t)1 << (uint64_t)m.levels);
+    std::lock_guard<std::mutex> lock(basis_function_mutex);
+    auto it = std::find_if(basis_function_cache.begin(), basis_function_cache.end(), [&](const basis_function& f)
+      {
+      return f.type == type && f.levels == m.levels && f.s == s && (s != custom || equal_steps(f.custom_steps, custom_steps));
+      });
+    if (it == basis_function_cache.end())
+      {
+      basis_function f;
+      f.type = type;
+      f.levels = m.levels;
+      f.s = s;
+      if (s == custom)
+        f.custom_steps = custom_steps;
+      const int top_level = m.levels - get_width(s);
+      const bool wavelet = type == bft_wavelet || type == bft_biorthogonal_wavelet;
+      const uint64_t index = n / 2 + (wavelet ? ((uint64_t)1 << (uint64_t)top_level) : 0);
+      if (top_level < 0)
+        {
+        f.first = index;
+        f.values.push_back(1.0);
+        }
+      else
+        {
+        const bool biorthogonal = type == bft_biorthogonal_scaling || type == bft_biorthogonal_wavelet;
+        const std::vector<lifting_step> steps = biorthogonal ? get_dual_lifting_steps(s, custom_steps) : get_lifting_steps(s, custom_steps);
+        f.values = impulse_response(f.first, index, 1.0, n, (uint32_t)top_level + 1, steps);
+        }
+      basis_function_cache.push_front(std::move(f));
+      if (basis_function_cache.size() > max_cached_basis_functions)
+        basis_function_cache.pop_back();
+      it = basis_function_cache.begin();
+      }
+    else
+      basis_function_cache.splice(basis_function_cache.begin(), basis_function_cache, it);
+    m.values.assign(n, 0.0);
+    std::copy(it->values.begin(), it->values.end(), m.values.begin() + it->first);
+    }
+  }
+
+void make_scaling_function(model& m, scheme s, const std::vector<lifting_step>& custom_steps)
+  {
+  make_basis_function(m, bft_scaling, s, custom_steps);
+  }
+
+void make_wavelet_function(model& m, scheme s, const std::vector<lifting_step>& custom_steps)
+  {
+  make_basis_function(m, bft_wavelet, s, custom_steps);
   }
 
 void make_biorthogonal_scaling_function(model& m, scheme s, const std::vector<lifting_step>& custom_steps)
   {
-  using namespace lifting;
-  uint64_t n = ((uint64_t)1 << (uint64_t)m.levels);
-  m.values.resize(n);
-  for (auto& v : m.values)
-    v = 0.0;
-  m.values[n / 2] = 1.0;
-  for (int lev = m.levels - get_width(s); lev >= 0; --lev)
-    biorthogonal_inverse(m.values.data(), n, lev, s, custom_steps);
+  make_basis_function(m, bft_biorthogonal_scaling, s, custom_steps);
   }
 
 void make_biorthogonal_wavelet_function(model& m, scheme s, const std::vector<lifting_step>& custom_steps)
   {
-  using namespace lifting;
-  uint64_t n = ((uint64_t)1 << (uint64_t)m.levels);
-  m.values.resize(n);
-  for (auto& v : m.values)
-    v = 0.0;
+  make_basis_function(m, bft_biorthogonal_wavelet, s, custom_steps);
+  }
 
+namespace
+  {
+  const uint64_t render_block_size = 1 << 16;
 
-  m.values[n / 2 + ((uint64_t)1 << (uint64_t)(m.levels - get_width(s)))] = 1.0;
-  for (int lev = m.levels - get_width(s); lev >= 0; --lev)
-    biorthogonal_inverse(m.values.data(), n, lev, s, custom_steps);
+  // ranges of one block of the signal and of the values, with the positions of the extremes of the values
+  struct block_summary
+    {
+    double signal_min, signal_max;
+    uint64_t min_index, max_index;
+    };
 
+  void summarize(block_summary& b, const std::vector<double>& signal, const std::vector<double>& values, uint64_t first, uint64_t last)
+    {
+    double signal_min = signal[0];
+    double signal_max = signal[0];
+    const uint64_t signal_last = std::min<uint64_t>(last, signal.size());
+    for (uint64_t i = std::min<uint64_t>(first, signal_last); i < signal_last; ++i)
+      {
+      signal_min = signal[i] < signal_min ? signal[i] : signal_min;
+      signal_max = signal[i] > signal_max ? signal[i] : signal_max;
+      }
+    b.signal_min = signal_min;
+    b.signal_max = signal_max;
+    uint64_t min_index = first;
+    uint64_t max_index = first;
+    for (uint64_t i = first + 1; i < last; ++i)
+      {
+      min_index = values[i] < values[min_index] ? i : min_index;
+      max_index = values[i] > values[max_index] ? i : max_index;
+      }
+    b.min_index = min_index;
+    b.max_index = max_index;
+    }
   }
 
-void fill_render_data(model& m, const std::vector<double>& values)
+void make_render_vertices(std::vector<float>& vertices, const std::vector<double>& signal, const std::vector<double>& values, uint64_t columns)
   {
-  using namespace jtk;
-  m.delete_render_objects();
+  if (signal.empty() || values.empty())
+    {
+    vertices.clear();
+    return;
+    }
+  const uint64_t n = values.size();
+  // with more than 4 samples per column only the first, minimum, maximum and last sample of each column are drawn (M4),
+  // which gives the same pixels as drawing all samples
+  const bool decimate = columns > 0 && n > 4 * columns;
+  const uint64_t nr_of_blocks = decimate ? columns : (n + render_block_size - 1) / render_block_size;
+  auto block_first = [&](uint64_t block)
+    {
+    return decimate ? block * n / columns : std::min<uint64_t>(n, block * render_block_size);
+    };
+
+  // one pass over both arrays for the ranges and the extremes of each column
+  std::vector<block_summary> blocks(nr_of_blocks);
+  parallel_for(0, nr_of_blocks, [&](uint64_t block)
+    {
+    summarize(blocks[block], signal, values, block_first(block), block_first(block + 1));
+    });
+  double min_value2 = values[blocks[0].min_index];
+  double max_value2 = values[blocks[0].max_index];
+  double signal_min = blocks[0].signal_min;
+  double signal_max = blocks[0].signal_max;
+  for (uint64_t block = 1; block < nr_of_blocks; ++block)
+    {
+    signal_min = std::min(signal_min, blocks[block].signal_min);
+    signal_max = std::max(signal_max, blocks[block].signal_max);
+    min_value2 = std::min(min_value2, values[blocks[block].min_index]);
+    max_value2 = std::max(max_value2, values[blocks[block].max_index]);
+    }
+  if (signal.size() > n)
+    {
+    // the part of the signal past the values is not in any block
+    for (uint64_t i = n; i < signal.size(); ++i)
+      {
+      signal_min = std::min(signal_min, signal[i]);
+      signal_max = std::max(signal_max, signal[i]);
+      }
+    }
+
   double cutoff = 1000000.0;
-  double max_value = *std::max_element(m.values.begin(), m.values.end());
-  double min_value = *std::min_element(m.values.begin(), m.values.end());
+  double max_value = signal_max;
+  double min_value = signal_min;
   if (max_value > cutoff)
     max_value = cutoff;
   if (min_value < -cutoff)
@@ -373,9 +567,6 @@ void fill_render_data(model& m, const std::vector<double>& values)
     }
   double range_original = max_value - min_value;
 
-  double max_value2 = *std::max_element(values.begin(), values.end());
-  double min_value2 = *std::min_element(values.begin(), values.end());
-
   double range2 = max_value2 - min_value2;
 
   if (range2 <= range_original)
@@ -391,37 +582,40 @@ void fill_render_data(model& m, const std::vector<double>& values)
     max_value = max_value2 - diff / 2.0;
     }
 
-
-  std::vector<GLfloat> vertices;
-  vertices.reserve(values.size() * 2);
-  uint64_t n = values.size();
-  for (uint64_t i = 0; i < n; ++i)
+  const float min_y = (float)min_value;
+  const float range_y = (float)max_value - (float)min_value;
+  auto set_vertex = [&](float* vertex, uint64_t i)
+    {
+    vertex[0] = (float)i / (float)(n - 1) * 2.f - 1.f;
+    vertex[1] = ((float)values[i] - min_y) / range_y * 1.8f - 0.9f;
+    };
+  if (!decimate)
     {
-    float pos_x = (float)i / (float)(n - 1) * 2.f - 1.f;
-    float pos_y = ((float)values[i] - (float)min_value) / ((float)max_value - (float)min_value) * 1.8f - 0.9f;
-    vertices.push_back(pos_x);
-    vertices.push_back(pos_y);
-    }
-
-  m._vao = new vertex_array_object();
-  m._vao->create();
-  gl_check_error(" _vao->create()");
-  m._vao->bind();
-  gl_check_error(" _vao->bind()");
-
-  m._vbo_array = new buffer_object(GL_ARRAY_BUFFER);
-  m._vbo_array->create();
-  gl_check_error("_vbo_array->create()");
-  m._vbo_array->bind();
-  gl_check_error("_vbo_array->bind()");
-  m._vbo_array->set_usage_pattern(GL_STATIC_DRAW);
-  m._vbo_array->allocate(vertices.data(), (int)(sizeof(GLfloat) * vertices.size()));
-  gl_check_error("_vbo_array->allocate()");
-  
-  m._vao->release();
-  gl_check_error("m._vao->release()");
-  m._vbo_array->release();
-  gl_check_error("m._vbo_array->release()");
+    vertices.resize(n * 2);
+    parallel_for(0, nr_of_blocks, [&](uint64_t block)
+      {
+      const uint64_t last = block_first(block + 1);
+      for (uint64_t i = block_first(block); i < last; ++i)
+        set_vertex(vertices.data() + 2 * i, i);
+      });
+    return;
+    }
+  vertices.clear();
+  vertices.reserve(columns * 8);
+  for (uint64_t column = 0; column < columns; ++column)
+    {
+    // the samples in the order of the line strip, without repeats
+    uint64_t index[4] = { block_first(column), blocks[column].min_index, blocks[column].max_index, block_first(column + 1) - 1 };
+    if (index[1] > index[2])
+      std::swap(index[1], index[2]);
+    for (int k = 0; k < 4; ++k)
+      {
+      if (k > 0 && index[k] == index[k - 1])
+        continue;
+      vertices.resize(vertices.size() + 2);
+      set_vertex(vertices.data() + vertices.size() - 2, index[k]);
+      }
+    }
   }
 
 double compute_volume(const std::vector<double>& values)
@@ -727,49 +921,54 @@ void smooth(model& m, double threshold, int smooth_level, scheme s, const std::v
     }
   }
 
-std::vector<lifting_step> parse(const std::string& wavelet_rules)
+void compile(std::vector<lifting_step>& rules, const std::string& wavelet_rules)
   {
-  std::vector<lifting_step> rules;
-  try
+  auto tokes = tokenize(wavelet_rules);
+  Program prog = make_program(tokes);
+  for (const auto& stm : prog.statements)
     {
-    auto tokes = tokenize(wavelet_rules);
-    Program prog = make_program(tokes);
-    for (const auto& stm : prog.statements)
+    if (std::holds_alternative<Tag>(stm))
       {
-      if (std::holds_alternative<Tag>(stm))
+      Tag t = std::get<Tag>(stm);
+      if (t.name == "predict")
         {
-        Tag t = std::get<Tag>(stm);
-        if (t.name == "predict")
-          {
-          rules.emplace_back();
-          rules.back().type = lst_predict;
-          }
-        else if (t.name == "update")
-          {
-          rules.emplace_back();
-          rules.back().type = lst_update;
-          }
-        else if (t.name == "scale_even")
-          {
-          rules.emplace_back();
-          rules.back().type = lst_scale_even;
-          }
-        else if (t.name == "scale_odd")
-          {
-          rules.emplace_back();
-          rules.back().type = lst_scale_odd;
-          }
+        rules.emplace_back();
+        rules.back().type = lst_predict;
         }
-      else
+      else if (t.name == "update")
+        {
+        rules.emplace_back();
+        rules.back().type = lst_update;
+        }
+      else if (t.name == "scale_even")
         {
-        if (rules.empty())
-          throw std::logic_error("error: tag missing (valid tags are update, predict, scale_even, scale_odd)");
-        Expression e = std::get<Expression>(stm);
-        double v = get_value(e);
-        rules.back().mask.push_back(v);
+        rules.emplace_back();
+        rules.back().type = lst_scale_even;
         }
+      else if (t.name == "scale_odd")
+        {
+        rules.emplace_back();
+        rules.back().type = lst_scale_odd;
+        }
+      }
+    else
+      {
+      if (rules.empty())
+        throw std::logic_error("error: tag missing (valid tags are update, predict, scale_even, scale_odd)");
+      Expression e = std::get<Expression>(stm);
+      double v = get_value(e);
+      rules.back().mask.push_back(v);
       }
     }
+  }
+
+std::vector<lifting_step> parse(const std::string& wavelet_rules)
+  {
+  std::vector<lifting_step> rules;
+  try
+    {
+    compile(rules, wavelet_rules);
+    }
   catch (std::logic_error e)
     {
     Logging::Error() << e.what() << "\n";
@@ -780,7 +979,24 @@ std::vector<lifting_step> parse(const std::string& wavelet_rules)
   return rules;
   }
 
-double compute_smoothness(const std::vector<double>& samples, double scale)
+std::string to_script(const lifting_step& step)
+  {
+  std::stringstream str;
+  switch (step.type)
+    {
+    case lst_predict: str << "predict;\n"; break;
+    case lst_update: str << "update;\n"; break;
+    case lst_scale_even: str << "scale_even;\n"; break;
+    case lst_scale_odd: str << "scale_odd;\n"; break;
+    }
+  str << std::setprecision(20);
+  for (size_t i = 0; i < step.mask.size(); ++i)
+    str << (i ? " " : "") << step.mask[i] << ";";
+  str << "\n";
+  return str.str();
+  }
+
+double compute_smoothness(const std::vector<double>& samples, double scale, std::string* error)
   {
   std::vector<double> P = samples;
   auto it = P.begin();
@@ -798,145 +1014,247 @@ double compute_smoothness(const std::vector<double>& samples, double scale)
     }
   catch (std::logic_error e)
     {
-    Logging::Error() << e.what() << "\n";
+    if (error)
+      *error = e.what();
+    else
+      Logging::Error() << e.what() << "\n";
     }
   return sob;
   }
 
-void analyze(scheme s, const std::vector<lifting_step>& custom_steps)
+scheme_analysis analyze_scheme(scheme s, const std::vector<lifting_step>& custom_steps)
   {
   using namespace lifting;
+  scheme_analysis a;
   uint64_t n = 32;
-  std::vector<double> samples((size_t)n, 0.0);
-  samples[n / 2] = 1.0;
-  switch (s)
-    {
-    case jamlet_linear: inverse_jamlet_linear(samples.data(), n, 0); break;
-    case jamlet_quadratic: inverse_jamlet_quadratic(samples.data(), n, 0); break;
-    case jamlet_cubic: inverse_jamlet_cubic(samples.data(), n, 0); break;
-    case jamlet_4_point: inverse_jamlet_4_point(samples.data(), n, 0); break;
-    case cdf_5_3: inverse_cdf_5_3(samples.data(), n, 0); break;
-    case cdf_9_7: inverse_cdf_9_7(samples.data(), n, 0); break;
-    case chaikin: inverse_chaikin(samples.data(), n, 0); break;
-    case cubic_bsplines: inverse_cubic_bsplines(samples.data(), n, 0); break;
-    case cubic_bspline_wavelets: inverse_cubic_bspline_wavelets(samples.data(), n, 0); break;
-    case daubechies_d4: inverse_daubechies_d4(samples.data(), n, 0); break;
-    case four_point: inverse_4_point(samples.data(), n, 0); break;
-    case haar: inverse_haar(samples.data(), n, 0); break;
-    case custom: inverse_custom(samples.data(), n, 0, custom_steps); break;
-    }
-  double sob_scaling = compute_smoothness(samples);
+  a.scaling.assign((size_t)n, 0.0);
+  a.scaling[n / 2] = 1.0;
+  inverse(a.scaling.data(), n, 0, s, custom_steps);
+  a.sob = compute_smoothness(a.scaling, 1.0, &a.sob_error);
+  a.scaling_sum = std::accumulate(a.scaling.begin(), a.scaling.end(), 0.0);
+
+  a.dual_scaling.assign((size_t)n, 0.0);
+  a.dual_scaling[n / 2] = 1.0;
+  biorthogonal_inverse(a.dual_scaling.data(), n, 0, s, custom_steps);
+  a.sob_dual = compute_smoothness(a.dual_scaling, 2.0, &a.sob_dual_error);
+
+  a.wavelet.assign((size_t)n, 0.0);
+  a.wavelet[n / 2 + 1] = 1.0;
+  inverse(a.wavelet.data(), n, 0, s, custom_steps);
+  a.wavelet_sum = std::accumulate(a.wavelet.begin(), a.wavelet.end(), 0.0);
+
+  std::vector<double> sample_vm((size_t)n, 0.0);
+  sample_vm[n / 2 + 1] = 1.0;
+  std::vector<double> vanishing_moment((size_t)2, 1.0);
+  iupdate(sample_vm.data(), n, vanishing_moment, 0, 1, false);
+  inverse(sample_vm.data(), n, 0, s, custom_steps);
+  double after_update_sum = std::accumulate(sample_vm.begin(), sample_vm.end(), 0.0);
+  a.update_mask_value = -a.wavelet_sum / (after_update_sum - a.wavelet_sum);
+  return a;
+  }
+
+void analyze(scheme s, const std::vector<lifting_step>& custom_steps)
+  {
+  const scheme_analysis a = analyze_scheme(s, custom_steps);
+  if (!a.sob_error.empty())
+    Logging::Error() << a.sob_error << "\n";
+  if (!a.sob_dual_error.empty())
+    Logging::Error() << a.sob_dual_error << "\n";
   Logging::GetInstance() << "Scaling coeff: ";
-  for (uint64_t i = 0; i < n; ++i)
-    Logging::GetInstance() << samples[i] << " ";
+  for (double v : a.scaling)
+    Logging::GetInstance() << v << " ";
   Logging::GetInstance() << "\n";
-  double scaling_sum = std::accumulate(samples.begin(), samples.end(), 0.0);
-  if (scaling_sum != 2.0)
+  if (a.scaling_sum != 2.0)
     {
-    Logging::GetInstance() << "Sum of scaling coefficients = " << scaling_sum << "\n";
-    Logging::GetInstance() << "It is advisable to add a even scale step with value " << scaling_sum / 2.0 << "\n";
+    Logging::GetInstance() << "Sum of scaling coefficients = " << a.scaling_sum << "\n";
+    Logging::GetInstance() << "It is advisable to add a even scale step with value " << a.scaling_sum / 2.0 << "\n";
     }
-  for (auto& smpl : samples)
-    smpl = 0.0;
-  samples[n / 2] = 1.0;
-  biorthogonal_inverse(samples.data(), n, 0, s, custom_steps);
-  double sob_scaling_dual = compute_smoothness(samples, 2.0);
   Logging::GetInstance() << "Biorthogonal scaling coeff: ";
-  for (uint64_t i = 0; i < n; ++i)
-    Logging::GetInstance() << samples[i] << " ";
+  for (double v : a.dual_scaling)
+    Logging::GetInstance() << v << " ";
   Logging::GetInstance() << "\n";
-  for (auto& smpl : samples)
-    smpl = 0.0;
-  samples[n / 2 + 1] = 1.0;
-  switch (s)
-    {
-    case jamlet_linear: inverse_jamlet_linear(samples.data(), n, 0); break;
-    case jamlet_quadratic: inverse_jamlet_quadratic(samples.data(), n, 0); break;
-    case jamlet_cubic: inverse_jamlet_cubic(samples.data(), n, 0); break;
-    case jamlet_4_point: inverse_jamlet_4_point(samples.data(), n, 0); break;
-    case cdf_5_3: inverse_cdf_5_3(samples.data(), n, 0); break;
-    case cdf_9_7: inverse_cdf_9_7(samples.data(), n, 0); break;
-    case chaikin: inverse_chaikin(samples.data(), n, 0); break;
-    case cubic_bsplines: inverse_cubic_bsplines(samples.data(), n, 0); break;
-    case cubic_bspline_wavelets: inverse_cubic_bspline_wavelets(samples.data(), n, 0); break;
-    case daubechies_d4: inverse_daubechies_d4(samples.data(), n, 0); break;
-    case four_point: inverse_4_point(samples.data(), n, 0); break;
-    case haar: inverse_haar(samples.data(), n, 0); break;
-    case custom: inverse_custom(samples.data(), n, 0, custom_steps); break;
-    }
   Logging::GetInstance() << "Wavelet coeff: ";
-  for (uint64_t i = 0; i < n; ++i)
-    Logging::GetInstance() << samples[i] << " ";
+  for (double v : a.wavelet)
+    Logging::GetInstance() << v << " ";
   Logging::GetInstance() << "\n";
-  double current_sum = std::accumulate(samples.begin(), samples.end(), 0.0);
-
-  std::vector<double> sample_vm((size_t)n, 0.0);
-  sample_vm[n / 2 + 1] = 1.0;
-  std::vector<double> vanishing_moment((size_t)2, 1.0);
-  iupdate(sample_vm.data(), n, vanishing_moment, 0, 1, false);
-  switch (s)
+  Logging::GetInstance() << "Current wavelet sum is " << a.wavelet_sum << "\n";
+  if (a.wavelet_sum)
     {
-    case jamlet_linear: inverse_jamlet_linear(sample_vm.data(), n, 0); break;
-    case jamlet_quadratic: inverse_jamlet_quadratic(sample_vm.data(), n, 0); break;
-    case jamlet_cubic: inverse_jamlet_cubic(sample_vm.data(), n, 0); break;
-    case jamlet_4_point: inverse_jamlet_4_point(sample_vm.data(), n, 0); break;
-    case cdf_5_3: inverse_cdf_5_3(sample_vm.data(), n, 0); break;
-    case cdf_9_7: inverse_cdf_9_7(sample_vm.data(), n, 0); break;
-    case chaikin: inverse_chaikin(sample_vm.data(), n, 0); break;
-    case cubic_bsplines: inverse_cubic_bsplines(sample_vm.data(), n, 0); break;
-    case cubic_bspline_wavelets: inverse_cubic_bspline_wavelets(sample_vm.data(), n, 0); break;
-    case daubechies_d4: inverse_daubechies_d4(sample_vm.data(), n, 0); break;
-    case four_point: inverse_4_point(sample_vm.data(), n, 0); break;
-    case haar: inverse_haar(sample_vm.data(), n, 0); break;
-    case custom: inverse_custom(sample_vm.data(), n, 0, custom_steps); break;
+    Logging::GetInstance() << "Add update step with mask value " << a.update_mask_value << " for one vanishing moment\n";
     }
-  double after_update_sum = std::accumulate(sample_vm.begin(), sample_vm.end(), 0.0);
-  double update_mask_value = -current_sum / (after_update_sum - current_sum);
-  Logging::GetInstance() << "Current wavelet sum is " << current_sum << "\n";
-  if (current_sum)
-    {
-    Logging::GetInstance() << "Add update step with mask value " << update_mask_value << " for one vanishing moment\n";
-    }
-  Logging::GetInstance() << "Riesz basis for ]" << -sob_scaling_dual << ", " << sob_scaling << "[\n";
+  Logging::GetInstance() << "Riesz basis for ]" << -a.sob_dual << ", " << a.sob << "[\n";
   }
 
 
 namespace
   {
-  double compute_vanishing_moment(const std::vector<lifting_step>& custom_steps)
+  /*
+  The moments sum_k k^p x[k], p < P, of a sequence x on the whole line, split in the sums over the even and over the
+  odd positions k. A lifting step changes the moments of one phase by the moments of the other phase, so the moments
+  of a wavelet follow exactly from the masks, without transforming samples.
+  */
+  struct polyphase_moments
     {
-    using namespace lifting;
-    uint64_t n = 32;
-    std::vector<double> samples((size_t)n, 0.0);
-    samples[n / 2 + 1] = 1.0;
-    inverse_custom(samples.data(), n, 0, custom_steps);
-    double current_sum = std::accumulate(samples.begin(), samples.end(), 0.0);
+    std::vector<double> even, odd;
+    };
+
+  // the moments of target after target[k] += sign * sum_j mask[j] * source[k + d_j], with d_j = 2(j + offset) - 1 as in
+  // ipredict (target odd, source even) and iupdate (target even, source odd)
+  void lift_moments(std::vector<double>& target, const std::vector<double>& source, const std::vector<double>& mask, double sign)
+    {
+    const int64_t offset = -(int64_t)(mask.size() >> 1) + 1;
+    const size_t P = target.size();
+    std::vector<double> binomial(P, 0.0);
+    for (size_t p = 0; p < P; ++p)
+      {
+      for (size_t q = p; q > 0; --q)
+        binomial[q] += binomial[q - 1];
+      binomial[0] = 1.0;
+      // sum_k k^p sum_j mask[j] source[k + d_j] = sum_j mask[j] sum_q binomial(p, q) (-d_j)^(p - q) sum_m m^q source[m]
+      double change = 0.0;
+      for (size_t j = 0; j < mask.size(); ++j)
+        {
+        const double minus_d = -(double)(2 * ((int64_t)j + offset) - 1);
+        double power = 1.0;
+        double sum = 0.0;
+        for (size_t q = p + 1; q > 0; --q)
+          {
+          sum += binomial[q - 1] * power * source[q - 1];
+          power *= minus_d;
+          }
+        change += mask[j] * sum;
+        }
+      target[p] += sign * change;
+      }
+    }
 
-    std::vector<double> sample_vm((size_t)n, 0.0);
-    sample_vm[n / 2 + 1] = 1.0;
-    std::vector<double> vanishing_moment((size_t)2, 1.0);
-    iupdate(sample_vm.data(), n, vanishing_moment, 0, 1, false);
-    inverse_custom(sample_vm.data(), n, 0, custom_steps);
-    double after_update_sum = std::accumulate(sample_vm.begin(), sample_vm.end(), 0.0);
-    double update_mask_value = -current_sum / (after_update_sum - current_sum);
-    return update_mask_value;
+  void inverse_custom_moments(polyphase_moments& m, const std::vector<lifting_step>& custom_steps)
+    {
+    for (auto rit = custom_steps.rbegin(); rit != custom_steps.rend(); ++rit)
+      {
+      switch (rit->type)
+        {
+        case lst_predict: lift_moments(m.odd, m.even, rit->mask, 1.0); break;
+        case lst_update: lift_moments(m.even, m.odd, rit->mask, -1.0); break;
+        case lst_scale_even: if (!rit->mask.empty()) for (auto& v : m.even) v /= rit->mask.front(); break;
+        case lst_scale_odd: if (!rit->mask.empty()) for (auto& v : m.odd) v /= rit->mask.front(); break;
+        }
+      }
     }
 
-  void _compute_smoothness(const std::vector<lifting_step>& custom_steps, double& sob, double& sob_dual)
+  // the first P moments of the wavelet of the custom steps followed by an update with the given mask
+  std::vector<double> wavelet_moments(const std::vector<lifting_step>& custom_steps, const std::vector<double>& update_mask, size_t P)
     {
-    using namespace lifting;
-    uint64_t n = 32;
-    std::vector<double> samples((size_t)n, 0.0);
-    samples[n / 2] = 1.0;
-    inverse_custom(samples.data(), n, 0, custom_steps);
-    sob = compute_smoothness(samples);
-    for (auto& smpl : samples)
-      smpl = 0.0;
-    samples[n / 2] = 1.0;
-    biorthogonal_inverse(samples.data(), n, 0, custom, custom_steps);
-    sob_dual = compute_smoothness(samples, 2.0);
+    polyphase_moments m;
+    m.even.assign(P, 0.0);
+    m.odd.assign(P, 1.0); // a single wavelet coefficient at position 1
+    lift_moments(m.even, m.odd, update_mask, -1.0);
+    inverse_custom_moments(m, custom_steps);
+    std::vector<double> moments(P);
+    for (size_t p = 0; p < P; ++p)
+      moments[p] = m.even[p] + m.odd[p];
+    return moments;
     }
 
+  // solves A x = b by Gaussian elimination with partial pivoting, A is stored row by row
+  std::vector<double> solve_linear_system(std::vector<double> A, std::vector<double> b)
+    {
+    const size_t n = b.size();
+    double max_entry = 0.0;
+    for (double v : A)
+      max_entry = std::max(max_entry, std::abs(v));
+    for (size_t c = 0; c < n; ++c)
+      {
+      size_t pivot = c;
+      for (size_t r = c + 1; r < n; ++r)
+        if (std::abs(A[r * n + c]) > std::abs(A[pivot * n + c]))
+          pivot = r;
+      if (!(std::abs(A[pivot * n + c]) > 1e-12 * max_entry))
+        throw std::runtime_error("the moment conditions have no unique solution");
+      if (pivot != c)
+        {
+        for (size_t k = 0; k < n; ++k)
+          std::swap(A[pivot * n + k], A[c * n + k]);
+        std::swap(b[pivot], b[c]);
+        }
+      for (size_t r = c + 1; r < n; ++r)
+        {
+        const double f = A[r * n + c] / A[c * n + c];
+        for (size_t k = c; k < n; ++k)
+          A[r * n + k] -= f * A[c * n + k];
+        b[r] -= f * b[c];
+        }
+      }
+    std::vector<double> x(n);
+    for (size_t c = n; c > 0; --c)
+      {
+      double sum = b[c - 1];
+      for (size_t k = c; k < n; ++k)
+        sum -= A[(c - 1) * n + k] * x[k];
+      x[c - 1] = sum / A[(c - 1) * n + c - 1];
+      }
+    return x;
+    }
+  }
+
+double compute_vanishing_moment(const std::vector<lifting_step>& custom_steps)
+  {
+  if (custom_steps.empty() || custom_steps.back().type != lst_update)
+    throw std::runtime_error("the vanishing moment needs an update as last step");
+  if (custom_steps.back().mask.size() < 2)
+    throw std::runtime_error("the last update needs at least 2 taps for the vanishing moment");
+  const std::vector<lifting_step> first_steps(custom_steps.begin(), custom_steps.end() - 1);
+  const std::vector<double>& mask = custom_steps.back().mask;
+  std::vector<double> central_pair(mask.size(), 0.0);
+  central_pair[mask.size() / 2 - 1] = 1.0;
+  central_pair[mask.size() / 2] = 1.0;
+  const double current_sum = wavelet_moments(first_steps, mask, 1)[0];
+  const double central_pair_sum = wavelet_moments(first_steps, central_pair, 1)[0] - wavelet_moments(first_steps, std::vector<double>(mask.size(), 0.0), 1)[0];
+  return -current_sum / central_pair_sum;
+  }
+
+lifting_step make_vanishing_moment_update(const std::vector<lifting_step>& custom_steps, int vanishing_moments)
+  {
+  if (vanishing_moments < 1)
+    throw std::runtime_error("the number of vanishing moments must be positive");
+  const size_t taps = (size_t)(vanishing_moments + vanishing_moments % 2);
+  // the moments are affine in the mask: moments(u) = moments(0) + A u, and moments(u) = 0 is solved for u
+  const std::vector<double> b = wavelet_moments(custom_steps, std::vector<double>(taps, 0.0), taps);
+  std::vector<double> A(taps * taps);
+  for (size_t j = 0; j < taps; ++j)
+    {
+    std::vector<double> unit(taps, 0.0);
+    unit[j] = 1.0;
+    const std::vector<double> column = wavelet_moments(custom_steps, unit, taps);
+    for (size_t p = 0; p < taps; ++p)
+      A[p * taps + j] = column[p] - b[p];
+    }
+  std::vector<double> minus_b(taps);
+  for (size_t p = 0; p < taps; ++p)
+    minus_b[p] = -b[p];
+  lifting_step step;
+  step.type = lst_update;
+  step.mask = solve_linear_system(A, minus_b);
+  return step;
+  }
+
+void compute_scheme_smoothness(const std::vector<lifting_step>& custom_steps, double& sob, double& sob_dual)
+  {
+  using namespace lifting;
+  uint64_t n = 32;
+  std::vector<double> samples((size_t)n, 0.0);
+  samples[n / 2] = 1.0;
+  inverse_custom(samples.data(), n, 0, custom_steps);
+  sob = compute_smoothness(samples);
+  for (auto& smpl : samples)
+    smpl = 0.0;
+  samples[n / 2] = 1.0;
+  biorthogonal_inverse(samples.data(), n, 0, custom, custom_steps);
+  sob_dual = compute_smoothness(samples, 2.0);
+  }
+
+namespace
+  {
   void do_construction(double alpha, std::vector<lifting_step>& custom_steps, double& sob, double& sob_dual)
     {
     assert(!custom_steps.empty());
@@ -948,33 +1266,120 @@ namespace
     double vm = compute_vanishing_moment(custom_steps);
     custom_steps.back().mask[1] = vm;
     custom_steps.back().mask[2] = vm;
-    _compute_smoothness(custom_steps, sob, sob_dual);
+    compute_scheme_smoothness(custom_steps, sob, sob_dual);
     }
   }
 
-void construct_stable_wavelet(std::vector<lifting_step>& custom_steps, double& sob, double& sob_dual)
+namespace
+  {
+  // sob_dual of the construction for alpha, minus infinity when a smoothness can not be computed
+  double construction_quality(double alpha, std::vector<lifting_step>& custom_steps)
+    {
+    double sob, sob_dual;
+    do_construction(alpha, custom_steps, sob, sob_dual);
+    if (sob_dual == sob_dual && sob == sob)
+      return sob_dual;
+    return -std::numeric_limits<double>::infinity();
+    }
+
+  // golden section search for the maximum of the quality in [a, b], best_alpha and best_quality hold the best point so far
+  void refine_construction(double a, double b, std::vector<lifting_step>& custom_steps, double& best_alpha, double& best_quality)
+    {
+    const double tolerance = 1e-9;
+    const double inv_phi = (std::sqrt(5.0) - 1.0) / 2.0;
+    double c = b - inv_phi * (b - a);
+    double d = a + inv_phi * (b - a);
+    double fc = construction_quality(c, custom_steps);
+    double fd = construction_quality(d, custom_steps);
+    while (b - a > tolerance)
+      {
+      if (fc > best_quality)
+        {
+        best_quality = fc;
+        best_alpha = c;
+        }
+      if (fd > best_quality)
+        {
+        best_quality = fd;
+        best_alpha = d;
+        }
+      if (fc >= fd)
+        {
+        b = d;
+        d = c;
+        fd = fc;
+        c = b - inv_phi * (b - a);
+        fc = construction_quality(c, custom_steps);
+        }
+      else
+        {
+        a = c;
+        c = d;
+        fc = fd;
+        d = a + inv_phi * (b - a);
+        fd = construction_quality(d, custom_steps);
+        }
+      }
+    }
+  }
+
+void construct_stable_wavelet(std::vector<lifting_step>& custom_steps, double& sob, double& sob_dual, const std::function<void(double)>& report)
   {
   custom_steps.emplace_back();
   custom_steps.back().type = lst_update;
   custom_steps.back().mask.resize(4);
-  sob_dual = -1000000000000.0;
-  double max_coeff = 2.0;
-  double alpha = -max_coeff;
+  const double max_coeff = 2.0;
+
+  // a coarse grid on [-max_coeff, max_coeff] in parallel, in chunks so that progress is reported from this thread
+  const uint64_t grid_size = 401;
+  const double grid_step = 2.0 * max_coeff / (double)(grid_size - 1);
+  const uint64_t nr_of_chunks = 8;
+  std::vector<double> quality(grid_size);
+  for (uint64_t chunk = 0; chunk < nr_of_chunks; ++chunk)
+    {
+    if (report)
+      report((double)chunk / (double)(nr_of_chunks + 1));
+    parallel_for(chunk * grid_size / nr_of_chunks, (chunk + 1) * grid_size / nr_of_chunks, [&](uint64_t i)
+      {
+      std::vector<lifting_step> steps = custom_steps;
+      quality[i] = construction_quality(-max_coeff + (double)i * grid_step, steps);
+      });
+    }
+  if (report)
+    report((double)nr_of_chunks / (double)(nr_of_chunks + 1));
+
+  // the best local maxima of the grid are refined by golden section search within one grid step
+  std::vector<uint64_t> candidates;
+  for (uint64_t i = 0; i < grid_size; ++i)
+    {
+    if (quality[i] == -std::numeric_limits<double>::infinity())
+      continue;
+    if ((i == 0 || quality[i] >= quality[i - 1]) && (i + 1 == grid_size || quality[i] >= quality[i + 1]))
+      candidates.push_back(i);
+    }
+  std::stable_sort(candidates.begin(), candidates.end(), [&](uint64_t left, uint64_t right) { return quality[left] > quality[right]; });
+  if (candidates.size() > 4)
+    candidates.resize(4);
+  std::vector<double> refined_alpha(candidates.size());
+  std::vector<double> refined_quality(candidates.size());
+  parallel_for(0, candidates.size(), [&](uint64_t k)
+    {
+    std::vector<lifting_step> steps = custom_steps;
+    const double alpha = -max_coeff + (double)candidates[k] * grid_step;
+    refined_alpha[k] = alpha;
+    refined_quality[k] = quality[candidates[k]];
+    refine_construction(std::max(-max_coeff, alpha - grid_step), std::min(max_coeff, alpha + grid_step), steps, refined_alpha[k], refined_quality[k]);
+    });
+
   double best_alpha = -max_coeff;
-  double step_size = 0.0001;
-  while (alpha <= max_coeff)
+  double best_quality = -std::numeric_limits<double>::infinity();
+  for (size_t k = 0; k < candidates.size(); ++k)
     {
-    double current_sob_dual;
-    do_construction(alpha, custom_steps, sob, current_sob_dual);
-    if (current_sob_dual == current_sob_dual && sob == sob)
+    if (refined_quality[k] > best_quality)
       {
-      if (current_sob_dual > sob_dual)
-        {
-        sob_dual = current_sob_dual;
-        best_alpha = alpha;
-        }
+      best_quality = refined_quality[k];
+      best_alpha = refined_alpha[k];
       }
-    alpha += step_size;
     }
   do_construction(best_alpha, custom_steps, sob, sob_dual);
   }
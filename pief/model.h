@@ -1,15 +1,10 @@
 #pragma once
 
+#include <functional>
 #include <vector>
 #include <stdint.h>
 #include <string>
 
-namespace jtk
-  {
-  class buffer_object;
-  class vertex_array_object;
-  }
-
 enum lifting_step_type
   {
   lst_predict,
@@ -22,9 +17,15 @@ struct lifting_step
   {
   lifting_step_type type;
   std::vector<double> mask;
+  int64_t only_scale_away_from_border = 1; // only used by the scale steps
   };
 
+// logs errors and the analysis of the scheme, on an error the steps up to the error are returned
 std::vector<lifting_step> parse(const std::string& wavelet_rules);
+// throws std::logic_error on an error, rules then holds the steps up to the error
+void compile(std::vector<lifting_step>& rules, const std::string& wavelet_rules);
+// the step in the syntax of the scripts
+std::string to_script(const lifting_step& step);
 
 enum scheme
   {
@@ -46,17 +47,29 @@ enum scheme
 struct model
   {
   model();
-  ~model();
-
-  void delete_render_objects();
 
   int levels;
   std::vector<double> values;
-
-  jtk::vertex_array_object* _vao;
-  jtk::buffer_object* _vbo_array;
   };
 
+// the lifting steps of a scheme in the order of the forward transform
+std::vector<lifting_step> get_lifting_steps(scheme s, const std::vector<lifting_step>& custom_steps);
+// the steps whose inverse is biorthogonal_inverse
+std::vector<lifting_step> get_dual_lifting_steps(scheme s, const std::vector<lifting_step>& custom_steps);
+
+// the scheme with the name of its enumerator, e.g. "cdf_9_7", throws std::runtime_error on an unknown name or "custom"
+scheme scheme_from_name(const std::string& name);
+
+const uint32_t max_default_levels = 12;
+// the most levels, up to max_default_levels, that a signal of n samples allows
+uint32_t default_levels(uint64_t n);
+
+// instantiated for double and float, so that float32 samples of a mapped file are transformed where they are
+template <class T>
+void forward(T* sample, uint64_t n, uint64_t level, scheme s, const std::vector<lifting_step>& custom_steps, uint64_t stride = 1, bool cyclical = false);
+template <class T>
+void inverse(T* sample, uint64_t n, uint64_t level, scheme s, const std::vector<lifting_step>& custom_steps, uint64_t stride = 1, bool cyclical = false);
+
 void biorthogonal_inverse(double* sample, uint64_t n, uint64_t level, scheme s, const std::vector<lifting_step>& custom_steps);
 
 void make_scaling_function(model& m, scheme s, const std::vector<lifting_step>& custom_steps);
@@ -65,7 +78,9 @@ void make_biorthogonal_scaling_function(model& m, scheme s, const std::vector<li
 void make_biorthogonal_wavelet_function(model& m, scheme s, const std::vector<lifting_step>& custom_steps);
 void make_test_function(model& m, int f);
 
-void fill_render_data(model& m, const std::vector<double>& values);
+// x y positions of the plot of values, scaled so that its range matches the range of the signal.
+// With columns > 0 the plot is decimated to at most 4 vertices per column when there are more samples than that.
+void make_render_vertices(std::vector<float>& vertices, const std::vector<double>& signal, const std::vector<double>& values, uint64_t columns = 0);
 
 double compute_volume(const std::vector<double>& values);
 
@@ -75,8 +90,33 @@ void get_wavelet_component(std::vector<double>& values, const model& m, int _lev
 double compress(model& m, double threshold, scheme s, const std::vector<lifting_step>& custom_steps);
 void smooth(model& m, double threshold, int smooth_level, scheme s, const std::vector<lifting_step>& custom_steps);
 
+// the scaling function, dual scaling function and wavelet of one level on 32 samples, with their smoothness
+struct scheme_analysis
+  {
+  std::vector<double> scaling, dual_scaling, wavelet;
+  double scaling_sum, wavelet_sum;
+  double update_mask_value; // the central pair of an update that gives a vanishing moment, if wavelet_sum is not zero
+  double sob, sob_dual; // the Riesz basis interval is ]-sob_dual, sob[
+  std::string sob_error, sob_dual_error; // why sob or sob_dual is NaN
+  };
+
+// does not log, the errors of the smoothness estimates are returned in the analysis
+scheme_analysis analyze_scheme(scheme s, const std::vector<lifting_step>& custom_steps);
+
+// logs analyze_scheme
 void analyze(scheme s, const std::vector<lifting_step>& custom_steps);
 
-double compute_smoothness(const std::vector<double>& samples, double scale = 1.0);
+// NaN when the smoothness can not be estimated, the reason goes to error when given and is logged otherwise
+double compute_smoothness(const std::vector<double>& samples, double scale = 1.0, std::string* error = nullptr);
+
+// the value to add to the central pair of the last step (an update) so that the wavelet gets a vanishing moment,
+// throws std::runtime_error when the last step is not an update of at least 2 taps
+double compute_vanishing_moment(const std::vector<lifting_step>& custom_steps);
+// the update step that, appended to the custom steps, gives the wavelet the vanishing moments, its mask has that
+// many taps rounded up to even (so an odd number gets one moment more)
+lifting_step make_vanishing_moment_update(const std::vector<lifting_step>& custom_steps, int vanishing_moments);
+// Sobolev smoothness of the scaling function and of the dual scaling function of a custom scheme
+void compute_scheme_smoothness(const std::vector<lifting_step>& custom_steps, double& sob, double& sob_dual);
 
-void construct_stable_wavelet(std::vector<lifting_step>& custom_steps, double& sob, double& sob_dual);
\ No newline at end of file
+// report gets the progress of the search in [0, 1], it may throw to abandon the search
+void construct_stable_wavelet(std::vector<lifting_step>& custom_steps, double& sob, double& sob_dual, const std::function<void(double)>& report = std::function<void(double)>());
\ No newline at end of file
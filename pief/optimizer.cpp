@@ -0,0 +1,254 @@
+#include "optimizer.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+
+namespace
+  {
+  const double initial_step = 0.25;
+  const double tolerance = 1e-9;
+  const uint64_t max_evaluations = 4000;
+  const int max_restarts = 4;
+
+  // the quality of a scheme as a function of the free coefficients, thread safe
+  class objective
+    {
+    public:
+      objective(const std::vector<lifting_step>& custom_steps, const std::vector<free_step>& free_steps) : _custom_steps(custom_steps), _free_steps(free_steps)
+        {
+        }
+
+      uint64_t dimension() const
+        {
+        uint64_t d = 0;
+        for (const auto& fs : _free_steps)
+          d += fs.taps / 2;
+        return d - 1; // the central pair of the last update gives the vanishing moment
+        }
+
+      // the first predict starts as linear interpolation, a predict after another predict and the updates as zero,
+      // so that the start is the scheme without the free steps, or that scheme with a linear prediction
+      std::vector<double> start() const
+        {
+        bool has_predict = std::any_of(_custom_steps.begin(), _custom_steps.end(), [](const lifting_step& step) { return step.type == lst_predict; });
+        std::vector<double> x;
+        for (const auto& fs : _free_steps)
+          {
+          const int free_values = &fs == &_free_steps.back() ? fs.taps / 2 - 1 : fs.taps / 2;
+          for (int k = 0; k < free_values; ++k)
+            x.push_back(fs.type == lst_predict && !has_predict && k == fs.taps / 2 - 1 ? 0.5 : 0.0);
+          if (fs.type == lst_predict)
+            has_predict = true;
+          }
+        return x;
+        }
+
+      void make_scheme(const std::vector<double>& x, std::vector<lifting_step>& steps) const
+        {
+        assert(x.size() == dimension());
+        steps = _custom_steps;
+        auto p = x.begin();
+        for (const auto& fs : _free_steps)
+          {
+          steps.emplace_back();
+          steps.back().type = fs.type;
+          steps.back().mask.resize(fs.taps);
+          const int free_values = &fs == &_free_steps.back() ? fs.taps / 2 - 1 : fs.taps / 2;
+          for (int k = 0; k < free_values; ++k, ++p)
+            {
+            steps.back().mask[k] = *p;
+            steps.back().mask[fs.taps - 1 - k] = *p;
+            }
+          }
+        std::vector<double>& mask = steps.back().mask;
+        const double vm = compute_vanishing_moment(steps);
+        mask[mask.size() / 2 - 1] = vm;
+        mask[mask.size() / 2] = vm;
+        }
+
+      // sob_dual, minus infinity when a smoothness can not be computed
+      double operator () (const std::vector<double>& x)
+        {
+        // the masks follow from the coefficients, so equal coefficients are equal masks
+          {
+          std::lock_guard<std::mutex> lock(_mutex);
+          auto it = _memo.find(x);
+          if (it != _memo.end())
+            return it->second;
+          }
+        std::vector<lifting_step> steps;
+        make_scheme(x, steps);
+        double sob, sob_dual;
+        compute_scheme_smoothness(steps, sob, sob_dual);
+        double quality = -std::numeric_limits<double>::infinity();
+        if (std::isfinite(sob) && std::isfinite(sob_dual) && std::isfinite(steps.back().mask[steps.back().mask.size() / 2]))
+          quality = sob_dual;
+        std::lock_guard<std::mutex> lock(_mutex);
+        _memo[x] = quality;
+        return quality;
+        }
+
+      uint64_t evaluations()
+        {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _memo.size();
+        }
+
+    private:
+      std::vector<lifting_step> _custom_steps;
+      std::vector<free_step> _free_steps;
+      std::mutex _mutex;
+      std::map<std::vector<double>, double> _memo;
+    };
+
+  struct vertex
+    {
+    std::vector<double> x;
+    double f;
+    };
+
+  void evaluate(std::vector<vertex>& points, objective& f)
+    {
+    parallel_for(0, points.size(), [&](uint64_t i)
+      {
+      points[i].f = f(points[i].x);
+      });
+    }
+
+  std::vector<double> combine(const std::vector<double>& a, const std::vector<double>& b, double t)
+    {
+    std::vector<double> x(a.size());
+    for (size_t i = 0; i < a.size(); ++i)
+      x[i] = a[i] + t * (b[i] - a[i]);
+    return x;
+    }
+
+  double simplex_size(const std::vector<vertex>& simplex)
+    {
+    double size = 0.0;
+    for (size_t i = 1; i < simplex.size(); ++i)
+      for (size_t j = 0; j < simplex[i].x.size(); ++j)
+        size = std::max(size, std::abs(simplex[i].x[j] - simplex[0].x[j]));
+    return size;
+    }
+
+  // Nelder-Mead search for the maximum of f, starting with a simplex around start
+  vertex nelder_mead(const std::vector<double>& start, objective& f, const std::function<void(double)>& report)
+    {
+    const uint64_t d = start.size();
+    std::vector<vertex> simplex(d + 1);
+    for (uint64_t i = 0; i <= d; ++i)
+      {
+      simplex[i].x = start;
+      if (i > 0)
+        simplex[i].x[i - 1] += initial_step;
+      }
+    evaluate(simplex, f);
+    auto better = [](const vertex& left, const vertex& right) { return left.f > right.f; };
+    std::stable_sort(simplex.begin(), simplex.end(), better);
+    while (simplex_size(simplex) > tolerance)
+      {
+      const uint64_t evaluations = f.evaluations();
+      if (evaluations >= max_evaluations)
+        break;
+      if (report)
+        report((double)evaluations / (double)max_evaluations);
+
+      std::vector<double> centroid(d, 0.0);
+      for (uint64_t i = 0; i < d; ++i)
+        for (uint64_t j = 0; j < d; ++j)
+          centroid[j] += simplex[i].x[j] / (double)d;
+      const vertex& worst = simplex[d];
+
+      // reflection, expansion, outside and inside contraction are evaluated at once
+      std::vector<vertex> candidates(4);
+      candidates[0].x = combine(centroid, worst.x, -1.0);
+      candidates[1].x = combine(centroid, worst.x, -2.0);
+      candidates[2].x = combine(centroid, worst.x, -0.5);
+      candidates[3].x = combine(centroid, worst.x, 0.5);
+      evaluate(candidates, f);
+      const vertex& reflection = candidates[0];
+      const vertex& expansion = candidates[1];
+      const vertex& outside = candidates[2];
+      const vertex& inside = candidates[3];
+
+      bool shrink = false;
+      if (reflection.f > simplex[0].f)
+        simplex[d] = expansion.f > reflection.f ? expansion : reflection;
+      else if (reflection.f > simplex[d - 1].f)
+        simplex[d] = reflection;
+      else if (reflection.f > worst.f)
+        {
+        if (outside.f >= reflection.f)
+          simplex[d] = outside;
+        else
+          shrink = true;
+        }
+      else
+        {
+        if (inside.f > worst.f)
+          simplex[d] = inside;
+        else
+          shrink = true;
+        }
+      if (shrink)
+        {
+        std::vector<vertex> shrunk(simplex.begin() + 1, simplex.end());
+        for (auto& v : shrunk)
+          v.x = combine(simplex[0].x, v.x, 0.5);
+        evaluate(shrunk, f);
+        std::copy(shrunk.begin(), shrunk.end(), simplex.begin() + 1);
+        }
+      std::stable_sort(simplex.begin(), simplex.end(), better);
+      }
+    return simplex[0];
+    }
+  }
+
+optimized_scheme optimize_scheme(const std::vector<lifting_step>& custom_steps, const std::vector<free_step>& free_steps, const std::function<void(double)>& report)
+  {
+  if (free_steps.empty())
+    throw std::runtime_error("there are no free steps to optimize");
+  for (const auto& fs : free_steps)
+    {
+    if (fs.type != lst_predict && fs.type != lst_update)
+      throw std::runtime_error("free steps must be predict or update steps");
+    if (fs.taps < 2 || fs.taps % 2 != 0)
+      throw std::runtime_error("free steps must have an even number of taps");
+    }
+  if (free_steps.back().type != lst_update)
+    throw std::runtime_error("the last free step must be an update step for the vanishing moment");
+
+  objective f(custom_steps, free_steps);
+  vertex best;
+  best.x = f.start();
+  best.f = f(best.x);
+  // restarting from the best point gets the search out of a simplex that collapsed too early
+  for (int restart = 0; restart < max_restarts && !best.x.empty(); ++restart)
+    {
+    const vertex v = nelder_mead(best.x, f, report);
+    const bool improved = v.f > best.f + tolerance;
+    if (v.f > best.f)
+      best = v;
+    if (!improved || f.evaluations() >= max_evaluations)
+      break;
+    }
+  if (report)
+    report(1.0);
+  if (!std::isfinite(best.f))
+    throw std::runtime_error("the optimization found no scheme with a stable dual, try other free steps");
+
+  optimized_scheme result;
+  f.make_scheme(best.x, result.steps);
+  compute_scheme_smoothness(result.steps, result.sob, result.sob_dual);
+  for (size_t i = custom_steps.size(); i < result.steps.size(); ++i)
+    result.script += (i > custom_steps.size() ? "\n" : "") + to_script(result.steps[i]);
+  result.evaluations = f.evaluations();
+  return result;
+  }
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "model.h"
+
+#include <functional>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/*
+Design of custom lifting schemes by numerical optimization.
+
+A number of free steps with symmetric masks is appended to a custom scheme, and their coefficients are chosen so that
+the dual scaling function is as smooth as possible (Sobolev smoothness, as estimated by sobsmthest). The last free
+step must be an update: its central pair is not free but follows from the other coefficients, so that the wavelet has
+a vanishing moment. With one free update of 4 taps this is the construction of construct_stable_wavelet.
+
+The search is a Nelder-Mead simplex method whose candidate points (reflection, expansion, both contractions, or the
+points of a shrink) are evaluated in parallel. Evaluations are memoized, so identical masks are never evaluated twice.
+*/
+
+struct free_step
+  {
+  lifting_step_type type; // lst_predict or lst_update
+  int taps; // even and at least 2
+  };
+
+struct optimized_scheme
+  {
+  std::vector<lifting_step> steps; // the custom steps followed by the free steps
+  double sob = 0.0;
+  double sob_dual = 0.0;
+  std::string script; // the free steps in the syntax of the scripts
+  uint64_t evaluations = 0; // the number of distinct schemes that were evaluated
+  };
+
+// report gets the progress of the search in [0, 1], it may throw to abandon the search
+// throws std::runtime_error when no evaluated scheme has a finite smoothness
+optimized_scheme optimize_scheme(const std::vector<lifting_step>& custom_steps, const std::vector<free_step>& free_steps, const std::function<void(double)>& report = std::function<void(double)>());
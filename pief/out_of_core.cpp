@@ -0,0 +1,432 @@
+#include "out_of_core.h"
+#include "lifting_range.h"
+#include "pyramid_file.h"
+
+#include "../lifting/lifting.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <future>
+#include <memory>
+#include <stdexcept>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#endif
+
+namespace
+  {
+
+  /*
+  Reads doubles sequentially, either from memory or from a file. The next buffer of the file is read in the
+  background while the current one is consumed.
+  */
+  class sample_reader
+    {
+    public:
+      sample_reader(const double* data, uint64_t size) : _data(data), _f(nullptr), _remaining(size), _pos(0), _next_size(0)
+        {
+        }
+
+      sample_reader(const std::string& filename, uint64_t size, uint64_t buffer_size) : _data(nullptr), _remaining(size), _pos(0), _next_size(0)
+        {
+        _f = fopen(filename.c_str(), "rb");
+        if (!_f)
+          throw std::runtime_error("cannot open " + filename);
+#if !defined(_WIN32)
+        posix_fadvise(fileno(_f), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+        _next.resize((size_t)buffer_size);
+        _fetch();
+        }
+
+      ~sample_reader()
+        {
+        if (_pending.valid())
+          _pending.wait();
+        if (_f)
+          fclose(_f);
+        }
+
+      void read(double* values, uint64_t count)
+        {
+        if (_data)
+          {
+          if (count > _remaining)
+            throw std::runtime_error("unexpected end of samples");
+          memcpy(values, _data, (size_t)count * sizeof(double));
+          _data += count;
+          _remaining -= count;
+          return;
+          }
+        while (count > 0)
+          {
+          if (_pos == _current.size())
+            {
+            if (!_pending.valid())
+              throw std::runtime_error("unexpected end of file");
+            if (_pending.get() != _next_size)
+              throw std::runtime_error("error reading file");
+            std::swap(_current, _next);
+            _current.resize((size_t)_next_size);
+            _pos = 0;
+            _fetch();
+            }
+          const uint64_t k = std::min<uint64_t>(count, _current.size() - _pos);
+          memcpy(values, _current.data() + _pos, (size_t)k * sizeof(double));
+          values += k;
+          _pos += k;
+          count -= k;
+          }
+        }
+
+    private:
+      void _fetch()
+        {
+        if (_remaining == 0)
+          return;
+        _next.resize(std::max(_next.size(), _current.size()));
+        _next_size = std::min<uint64_t>(_remaining, _next.size());
+        _remaining -= _next_size;
+        _pending = std::async(std::launch::async, [this]()
+          {
+          return (uint64_t)fread(_next.data(), sizeof(double), (size_t)_next_size, _f);
+          });
+        }
+
+    private:
+      const double* _data;
+      FILE* _f;
+      uint64_t _remaining;
+      std::vector<double> _current, _next;
+      uint64_t _pos, _next_size;
+      std::future<uint64_t> _pending;
+    };
+
+  /*
+  Writes doubles sequentially, either to memory or to a file. A full buffer is written in the background
+  while the next one is filled.
+  */
+  class sample_writer
+    {
+    public:
+      sample_writer(double* data) : _data(data), _f(nullptr)
+        {
+        }
+
+      sample_writer(const std::string& filename, uint64_t buffer_size) : _data(nullptr), _filename(filename)
+        {
+        _f = fopen(filename.c_str(), "wb");
+        if (!_f)
+          throw std::runtime_error("cannot create " + filename);
+        _current.reserve((size_t)buffer_size);
+        _next.reserve((size_t)buffer_size);
+        }
+
+      ~sample_writer()
+        {
+        if (_pending.valid())
+          _pending.wait();
+        if (_f)
+          fclose(_f);
+        }
+
+      void write(const double* values, uint64_t count)
+        {
+        if (_data)
+          {
+          memcpy(_data, values, (size_t)count * sizeof(double));
+          _data += count;
+          return;
+          }
+        while (count > 0)
+          {
+          const uint64_t k = std::min<uint64_t>(count, _current.capacity() - _current.size());
+          _current.insert(_current.end(), values, values + k);
+          values += k;
+          count -= k;
+          if (_current.size() == _current.capacity())
+            _write_current();
+          }
+        }
+
+      void close()
+        {
+        if (!_f)
+          return;
+        _write_current();
+        _wait();
+        const bool failed = fclose(_f) != 0;
+        _f = nullptr;
+        if (failed)
+          throw std::runtime_error("error writing " + _filename);
+        }
+
+    private:
+      void _wait()
+        {
+        if (_pending.valid() && !_pending.get())
+          throw std::runtime_error("error writing " + _filename);
+        }
+
+      void _write_current()
+        {
+        _wait();
+        std::swap(_current, _next);
+        _current.clear();
+        if (_next.empty())
+          return;
+        _pending = std::async(std::launch::async, [this]()
+          {
+          return fwrite(_next.data(), sizeof(double), _next.size(), _f) == _next.size();
+          });
+        }
+
+    private:
+      double* _data;
+      FILE* _f;
+      std::string _filename;
+      std::vector<double> _current, _next;
+      std::future<bool> _pending;
+    };
+
+  /*
+  The cone of a block of pairs only moves to the right, so the untouched input samples of the cone are kept in
+  a sliding window and only the new samples are read. The lifting itself happens on a copy of the window, because
+  the halo samples are only partially lifted at the end of a block.
+  */
+  struct sliding_window
+    {
+    std::vector<double> raw;
+    uint64_t first_pair = 0;
+    std::vector<double> work;
+    };
+
+  template <class TFill>
+  void slide(sliding_window& w, const pair_range& input, TFill fill)
+    {
+    const uint64_t drop = std::min<uint64_t>(w.raw.size(), 2 * (input.first - w.first_pair));
+    w.raw.erase(w.raw.begin(), w.raw.begin() + drop);
+    w.first_pair = input.first;
+    const uint64_t old_size = w.raw.size();
+    w.raw.resize((size_t)(2 * (input.last - input.first)));
+    fill(w.raw.data() + old_size, w.first_pair + old_size / 2, input.last);
+    w.work = w.raw;
+    }
+
+  // one forward level over the m samples of 'in', in blocks of block_pairs pairs
+  void stream_forward_level(sample_reader& in, uint64_t m, const std::vector<lifting_step>& steps, uint64_t block_pairs, double* details, sample_writer& coarse)
+    {
+    const uint64_t nr_of_pairs = m / 2;
+    sliding_window w;
+    std::vector<double> even;
+    for (uint64_t p0 = 0; p0 < nr_of_pairs; p0 += block_pairs)
+      {
+      const uint64_t p1 = std::min<uint64_t>(nr_of_pairs, p0 + block_pairs);
+      pair_range input;
+      const auto ranges = forward_ranges(steps, { p0, p1 }, nr_of_pairs, input);
+      slide(w, input, [&](double* values, uint64_t first, uint64_t last)
+        {
+        in.read(values, 2 * (last - first));
+        });
+      const uint64_t offset = 2 * w.first_pair;
+      forward_range(w.work.data(), m, 0, steps, ranges, offset);
+      even.resize((size_t)(p1 - p0));
+      for (uint64_t p = p0; p < p1; ++p)
+        {
+        even[p - p0] = w.work[2 * p - offset];
+        details[p] = w.work[2 * p + 1 - offset];
+        }
+      coarse.write(even.data(), even.size());
+      }
+    }
+
+  // one inverse level: the even samples come from 'coarse', the odd ones from 'details', the m results go to 'out'
+  void stream_inverse_level(sample_reader& coarse, const double* details, uint64_t m, const std::vector<lifting_step>& steps, uint64_t block_pairs, sample_writer& out)
+    {
+    const uint64_t nr_of_pairs = m / 2;
+    sliding_window w;
+    std::vector<double> even;
+    for (uint64_t p0 = 0; p0 < nr_of_pairs; p0 += block_pairs)
+      {
+      const uint64_t p1 = std::min<uint64_t>(nr_of_pairs, p0 + block_pairs);
+      pair_range input;
+      const auto ranges = inverse_ranges(steps, { p0, p1 }, nr_of_pairs, input);
+      slide(w, input, [&](double* values, uint64_t first, uint64_t last)
+        {
+        even.resize((size_t)(last - first));
+        coarse.read(even.data(), even.size());
+        for (uint64_t p = first; p < last; ++p)
+          {
+          values[2 * (p - first)] = even[p - first];
+          values[2 * (p - first) + 1] = details[p];
+          }
+        });
+      const uint64_t offset = 2 * w.first_pair;
+      inverse_range(w.work.data(), m, 0, steps, ranges, offset);
+      out.write(w.work.data() + (2 * p0 - offset), 2 * (p1 - p0));
+      }
+    }
+
+  uint64_t get_buffer_size(uint64_t memory_budget)
+    {
+    return std::max<uint64_t>(4096, memory_budget / (16 * sizeof(double)));
+    }
+
+  std::string temporary_filename(const std::string& filename, uint32_t level)
+    {
+    return filename + (level & 1 ? ".tmp1" : ".tmp0");
+    }
+
+  void remove_temporary_files(const std::string& filename)
+    {
+    std::error_code ec;
+    std::filesystem::remove(temporary_filename(filename, 0), ec);
+    std::filesystem::remove(temporary_filename(filename, 1), ec);
+    }
+  }
+
+void out_of_core_forward(const std::string& input_filename, const std::string& pyramid_filename, uint32_t levels, scheme s, const std::vector<lifting_step>& custom_steps, uint64_t memory_budget)
+  {
+  const uint64_t file_size = std::filesystem::file_size(input_filename);
+  if (file_size % sizeof(double) != 0)
+    throw std::runtime_error(input_filename + " is not a file of doubles");
+  const uint64_t n = file_size / sizeof(double);
+  pyramid_file pyr(pyramid_filename, n, levels, s, custom_steps);
+  const std::vector<lifting_step> steps = get_lifting_steps(s, custom_steps);
+  const uint64_t buffer_size = get_buffer_size(memory_budget);
+
+  // without levels the coarse block is the signal
+  if (levels == 0)
+    {
+    sample_reader(input_filename, n, buffer_size).read(pyr.writable_coarse().data, n);
+    pyr.flush();
+    return;
+    }
+
+  try
+    {
+    std::vector<double> values; // the samples of the current level, once they fit in memory
+    if (file_size <= memory_budget)
+      {
+      values.resize((size_t)n);
+      sample_reader(input_filename, n, buffer_size).read(values.data(), n);
+      }
+    uint64_t m = n;
+    uint32_t level = 0;
+    while (values.empty() && level < levels)
+      {
+      sample_reader in(level == 0 ? input_filename : temporary_filename(pyramid_filename, level - 1), m, buffer_size);
+      const bool next_in_memory = (m / 2) * sizeof(double) <= memory_budget;
+      if (level + 1 == levels)
+        {
+        sample_writer coarse(pyr.writable_coarse().data);
+        stream_forward_level(in, m, steps, buffer_size, pyr.writable_details(level).data, coarse);
+        }
+      else if (next_in_memory)
+        {
+        values.resize((size_t)(m / 2));
+        sample_writer coarse(values.data());
+        stream_forward_level(in, m, steps, buffer_size, pyr.writable_details(level).data, coarse);
+        }
+      else
+        {
+        sample_writer coarse(temporary_filename(pyramid_filename, level), buffer_size);
+        stream_forward_level(in, m, steps, buffer_size, pyr.writable_details(level).data, coarse);
+        coarse.close();
+        }
+      m /= 2;
+      ++level;
+      }
+
+    if (!values.empty())
+      {
+      // levels [level, levels) in memory, level 0 of 'values' is 'level' of the pyramid
+      for (uint32_t lev = level; lev < levels; ++lev)
+        forward(values.data(), m, lev - level, s, custom_steps);
+      for (uint32_t lev = level; lev < levels; ++lev)
+        {
+        const coefficient_span d = pyr.writable_details(lev);
+        for (uint64_t k = 0; k < d.size; ++k)
+          d[k] = values[((k << 1) + 1) << (lev - level)];
+        }
+      const coefficient_span c = pyr.writable_coarse();
+      for (uint64_t k = 0; k < c.size; ++k)
+        c[k] = values[k << (levels - level)];
+      }
+    }
+  catch (...)
+    {
+    remove_temporary_files(pyramid_filename);
+    throw;
+    }
+  remove_temporary_files(pyramid_filename);
+  pyr.flush();
+  }
+
+void out_of_core_inverse(const std::string& pyramid_filename, const std::string& output_filename, uint64_t memory_budget)
+  {
+  const pyramid_file pyr(pyramid_filename);
+  const pyramid_header& h = pyr.header();
+  const std::vector<lifting_step> steps = get_lifting_steps(h.s, h.custom_steps);
+  const uint64_t buffer_size = get_buffer_size(memory_budget);
+
+  // the finest level whose samples fit in memory
+  uint32_t first_level = h.levels;
+  while (first_level > 0 && (h.n >> (first_level - 1)) * sizeof(double) <= memory_budget)
+    --first_level;
+
+  std::vector<double> values;
+  const double* coarse = pyr.coarse().data;
+  if (first_level < h.levels)
+    {
+    const uint64_t m = h.n >> first_level;
+    values.resize((size_t)m);
+    const const_coefficient_span c = pyr.coarse();
+    for (uint64_t k = 0; k < c.size; ++k)
+      values[k << (h.levels - first_level)] = c[k];
+    for (uint32_t lev = first_level; lev < h.levels; ++lev)
+      {
+      const const_coefficient_span d = pyr.details(lev);
+      for (uint64_t k = 0; k < d.size; ++k)
+        values[((k << 1) + 1) << (lev - first_level)] = d[k];
+      }
+    for (uint32_t lev = h.levels; lev > first_level; --lev)
+      inverse(values.data(), m, lev - 1 - first_level, h.s, h.custom_steps);
+    coarse = values.data();
+    }
+
+  // coarse holds the whole signal, also without levels
+  if (first_level == 0)
+    {
+    sample_writer out(output_filename, buffer_size);
+    out.write(coarse, h.n);
+    out.close();
+    return;
+    }
+
+  try
+    {
+    for (uint32_t level = first_level; level > 0; --level)
+      {
+      const uint32_t lev = level - 1;
+      const uint64_t m = h.n >> lev;
+      std::unique_ptr<sample_reader> in;
+      if (level == first_level)
+        in.reset(new sample_reader(coarse, m / 2));
+      else
+        in.reset(new sample_reader(temporary_filename(output_filename, level), m / 2, buffer_size));
+      sample_writer out(lev == 0 ? output_filename : temporary_filename(output_filename, lev), buffer_size);
+      stream_inverse_level(*in, pyr.details(lev).data, m, steps, buffer_size, out);
+      out.close();
+      }
+    }
+  catch (...)
+    {
+    remove_temporary_files(output_filename);
+    throw;
+    }
+  remove_temporary_files(output_filename);
+  }
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "model.h"
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/*
+Lifting transforms of signals that do not fit in memory.
+
+The input of out_of_core_forward is a raw file of native doubles. Each level is streamed in blocks of pairs: a block
+reads its dependency cone (the block plus a small halo of neighbouring pairs, see lifting_range.h), lifts it, and
+writes its details straight into the pyramid and its coarse samples to a temporary file that is the input of the
+next level. Reading and writing run asynchronously with the lifting. As soon as a level fits in memory_budget bytes
+the remaining levels are done in memory.
+
+out_of_core_inverse does the opposite: it reads a pyramid file (see pyramid_file.h) and writes the raw signal.
+
+Temporary files are written next to the output file. The results are identical to forward/inverse in memory.
+*/
+
+const uint64_t default_memory_budget = (uint64_t)256 * 1024 * 1024;
+
+void out_of_core_forward(const std::string& input_filename, const std::string& pyramid_filename, uint32_t levels, scheme s, const std::vector<lifting_step>& custom_steps, uint64_t memory_budget = default_memory_budget);
+
+void out_of_core_inverse(const std::string& pyramid_filename, const std::string& output_filename, uint64_t memory_budget = default_memory_budget);
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+#include <algorithm>
+#include <exception>
+#include <thread>
+#include <vector>
+
+/*
+Calls f(i) for each i in [first, last). The range is split in contiguous blocks, one per core.
+An exception thrown by f is rethrown in the calling thread once all blocks are finished.
+*/
+template <class TFunc>
+void parallel_for(uint64_t first, uint64_t last, TFunc f)
+  {
+  if (last <= first)
+    return;
+  const uint64_t count = last - first;
+  const uint64_t nr_of_threads = std::min<uint64_t>(count, std::max<uint64_t>(1, (uint64_t)std::thread::hardware_concurrency()));
+  const uint64_t block_size = (count + nr_of_threads - 1) / nr_of_threads;
+  std::vector<std::exception_ptr> errors((size_t)nr_of_threads);
+  auto run_block = [&](uint64_t block)
+    {
+    const uint64_t block_first = first + block * block_size;
+    const uint64_t block_last = std::min<uint64_t>(last, block_first + block_size);
+    try
+      {
+      for (uint64_t i = block_first; i < block_last; ++i)
+        f(i);
+      }
+    catch (...)
+      {
+      errors[block] = std::current_exception();
+      }
+    };
+  std::vector<std::thread> threads;
+  threads.reserve((size_t)nr_of_threads);
+  for (uint64_t block = 1; block < nr_of_threads; ++block)
+    threads.emplace_back(run_block, block);
+  run_block(0);
+  for (auto& t : threads)
+    t.join();
+  for (const auto& e : errors)
+    {
+    if (e)
+      std::rethrow_exception(e);
+    }
+  }
@@ -0,0 +1,154 @@
+#include "pipeline.h"
+#include "logging.h"
+#include "signal_file.h"
+
+#include <algorithm>
+#include <cmath>
+
+pipeline::pipeline() : _has_steps(false), _requested_scheme(jamlet_linear), _scheme(jamlet_linear), _steps_version(0),
+_source_steps_version(0), _source_version(0), _operation_source_version(0), _operation_steps_version(0), _signal_version(0), _components_signal_version(0), _components_steps_version(0),
+_space(-1), _level(-1), _component_signal_version(0), _component(nullptr), _component_version(0), _volume(0.0)
+  {
+  }
+
+bool pipeline::update(const pipeline_settings& settings, const std::function<void(double)>& report)
+  {
+  const uint64_t component_version = _component_version;
+  // every stage is complete when report is called, so an update that is abandoned leaves a valid state
+  if (report)
+    report(0.0);
+  _update_steps(settings);
+  if (report)
+    report(0.1);
+  _update_source(settings);
+  if (report)
+    report(0.5);
+  _update_operation(settings);
+  if (report)
+    report(0.75);
+  _update_component(settings);
+  return _component_version != component_version;
+  }
+
+void pipeline::_update_steps(const pipeline_settings& settings)
+  {
+  if (_has_steps && settings.s == _requested_scheme && (settings.s != custom || settings.script == _script))
+    return;
+  // a viewer that shows the fallback of an empty script asks for the fallback next, which is the same result
+  if (_has_steps && settings.s != custom && settings.s == _scheme && _steps.empty())
+    {
+    _requested_scheme = settings.s;
+    return;
+    }
+  _has_steps = true;
+  _requested_scheme = settings.s;
+  _script = settings.script;
+  _scheme = settings.s;
+  _steps.clear();
+  if (_scheme == custom)
+    {
+    _steps = parse(_script);
+    if (_steps.empty())
+      _scheme = jamlet_linear;
+    }
+  ++_steps_version;
+  }
+
+void pipeline::_update_source(const pipeline_settings& settings)
+  {
+  const bool uses_scheme = settings.function_type < 4;
+  if (_source_version > 0 && settings.levels == _source_key.levels && settings.function_type == _source_key.function_type)
+    {
+    if (uses_scheme && _source_steps_version == _steps_version)
+      return;
+    if (settings.function_type == 4 && settings.test_function == _source_key.test_function)
+      return;
+    if (settings.function_type == 5 && settings.signal_filename == _source_key.signal_filename)
+      return;
+    }
+  if (settings.function_type == 5)
+    {
+    // a file that cannot be read throws and leaves the previous source in place
+    model source;
+    source.levels = settings.levels;
+    make_signal_function(source, settings.signal_filename);
+    _source = std::move(source);
+    }
+  _source_key = settings;
+  _source_steps_version = _steps_version;
+  _source.levels = settings.levels;
+  switch (settings.function_type)
+    {
+    case 0: make_scaling_function(_source, _scheme, _steps); break;
+    case 1: make_wavelet_function(_source, _scheme, _steps); break;
+    case 2: make_biorthogonal_scaling_function(_source, _scheme, _steps); break;
+    case 3: make_biorthogonal_wavelet_function(_source, _scheme, _steps); break;
+    case 4: make_test_function(_source, settings.test_function); break;
+    }
+  ++_source_version;
+  }
+
+void pipeline::_update_operation(const pipeline_settings& settings)
+  {
+  if (_signal_version > 0 && _operation_source_version == _source_version && settings.operation == _operation_key.operation
+    && (settings.operation == 0 || _operation_steps_version == _steps_version))
+    {
+    if (settings.operation == 0)
+      return;
+    if (_operation_key.threshold == settings.threshold && (settings.operation != 2 || _operation_key.smooth_level == settings.smooth_level))
+      return;
+    }
+  _operation_key = settings;
+  _operation_source_version = _source_version;
+  _operation_steps_version = _steps_version;
+  _signal.levels = _source.levels;
+  _signal.values = _source.values;
+  if (settings.operation == 1)
+    {
+    const double ratio = compress(_signal, settings.threshold, _scheme, _steps);
+    Logging::GetInstance() << "Compression ratio equals " << ratio*100.0 << "%%\n";
+    }
+  else if (settings.operation == 2)
+    smooth(_signal, settings.threshold, settings.smooth_level, _scheme, _steps);
+  if (settings.operation != 0)
+    {
+    double max_error = 0.0;
+    double l2_error = 0.0;
+    for (uint64_t i = 0; i < _source.values.size(); ++i)
+      {
+      max_error = std::max<double>(max_error, std::abs(_source.values[i] - _signal.values[i]));
+      l2_error += pow(_source.values[i] - _signal.values[i], 2.0);
+      }
+    l2_error = std::sqrt(l2_error);
+    Logging::GetInstance() << "l_inf error: " << max_error << "\n";
+    Logging::GetInstance() << "l2 error: " << l2_error << "\n";
+    }
+  ++_signal_version;
+  }
+
+void pipeline::_update_component(const pipeline_settings& settings)
+  {
+  const bool uses_components = !(settings.space == 0 && settings.level == _signal.levels);
+  if (_component_signal_version == _signal_version && settings.space == _space && settings.level == _level
+    && (!uses_components || _components_steps_version == _steps_version))
+    return;
+  _component_signal_version = _signal_version;
+  _space = settings.space;
+  _level = settings.level;
+  if (!uses_components)
+    _component = &_signal.values;
+  else
+    {
+    // all components come from one forward transform, kept until the signal changes
+    if (_components.empty() || _components_signal_version != _signal_version || _components_steps_version != _steps_version)
+      {
+      _components = component_pyramid(_signal.values, _signal.levels, _scheme, _steps);
+      _components_signal_version = _signal_version;
+      _components_steps_version = _steps_version;
+      }
+    _component = _space == 0 ? &_components.spline(_level) : &_components.wavelet(_level);
+    }
+  _volume = compute_volume(*_component);
+  Logging::GetInstance() << "Volume equals " << _volume << "\n";
+  ++_component_version;
+  }
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "components.h"
+#include "model.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/*
+The computations behind the viewer as a cached stage graph:
+
+  script -> steps -> source signal -> operation -> components -> component
+
+Every stage remembers the inputs it was computed from and is only recomputed when they changed, so an interactive
+change only costs its own stage and the stages after it. Each stage has a version that increases when its result
+changes, so a consumer (like the vertex buffer of the viewer) can check whether it is out of date.
+The pipeline does not use OpenGL and can run headless.
+*/
+
+struct pipeline_settings
+  {
+  int levels = 12;
+  scheme s = jamlet_linear;
+  std::string script; // only used by the custom scheme
+  int function_type = 0; // scaling, wavelet, biorthogonal scaling, biorthogonal wavelet, test function, signal file
+  int test_function = 0;
+  std::string signal_filename; // only used by the signal file, see signal_file.h
+  int operation = 0; // original, compress, smooth
+  double threshold = 0.01;
+  int smooth_level = 2;
+  int space = 0; // 0 is spline space, 1 is wavelet space
+  int level = 12;
+  };
+
+class pipeline
+  {
+  public:
+    pipeline();
+
+    // brings all stages up to date, returns true if the component changed
+    // report gets the progress in [0, 1] before each stage, it may throw to abandon the update between two stages
+    bool update(const pipeline_settings& settings, const std::function<void(double)>& report = std::function<void(double)>());
+
+    // a custom scheme whose script has no steps falls back to jamlet_linear
+    scheme active_scheme() const { return _scheme; }
+    const std::vector<lifting_step>& custom_steps() const { return _steps; }
+
+    // the source signal after the operation
+    const model& signal() const { return _signal; }
+    uint64_t signal_version() const { return _signal_version; }
+
+    // the spline or wavelet component of the signal that the settings ask for
+    const std::vector<double>& component() const { return *_component; }
+    uint64_t component_version() const { return _component_version; }
+    double volume() const { return _volume; }
+
+  private:
+    void _update_steps(const pipeline_settings& settings);
+    void _update_source(const pipeline_settings& settings);
+    void _update_operation(const pipeline_settings& settings);
+    void _update_component(const pipeline_settings& settings);
+
+  private:
+    bool _has_steps;
+    scheme _requested_scheme;
+    std::string _script;
+    scheme _scheme;
+    std::vector<lifting_step> _steps;
+    uint64_t _steps_version;
+
+    pipeline_settings _source_key;
+    uint64_t _source_steps_version;
+    model _source;
+    uint64_t _source_version;
+
+    pipeline_settings _operation_key;
+    uint64_t _operation_source_version;
+    uint64_t _operation_steps_version;
+    model _signal;
+    uint64_t _signal_version;
+
+    component_pyramid _components;
+    uint64_t _components_signal_version;
+    uint64_t _components_steps_version;
+
+    int _space, _level;
+    uint64_t _component_signal_version;
+    const std::vector<double>* _component;
+    uint64_t _component_version;
+    double _volume;
+  };
@@ -0,0 +1,244 @@
+#include "pyramid_file.h"
+
+#include "../lifting/lifting.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+  {
+  const char pyramid_magic[8] = { 'P', 'I', 'E', 'F', 'P', 'Y', 'R', 'M' };
+  const uint32_t version = 1;
+  const uint64_t block_alignment = 4096;
+
+  uint64_t align(uint64_t offset)
+    {
+    return (offset + block_alignment - 1) & ~(block_alignment - 1);
+    }
+
+  template <class T>
+  void write_value(std::vector<char>& buffer, T value)
+    {
+    const char* p = reinterpret_cast<const char*>(&value);
+    buffer.insert(buffer.end(), p, p + sizeof(T));
+    }
+
+  template <class T>
+  T read_value(const char*& p, const char* end)
+    {
+    if (p + sizeof(T) > end)
+      throw std::runtime_error("pyramid file header is corrupt");
+    T value;
+    memcpy(&value, p, sizeof(T));
+    p += sizeof(T);
+    return value;
+    }
+
+  uint64_t block_size(const pyramid_header& h, uint32_t block)
+    {
+    if (block == 0)
+      return h.n >> h.levels;
+    const uint32_t level = h.levels - block;
+    return h.n >> (level + 1);
+    }
+
+  std::vector<char> encode_header(const pyramid_header& h, std::vector<uint64_t>& offsets)
+    {
+    uint64_t header_size = sizeof(pyramid_magic) + 4 * sizeof(uint32_t) + sizeof(uint64_t) + (h.levels + 1) * sizeof(uint64_t);
+    for (const auto& step : h.custom_steps)
+      header_size += 2 * sizeof(int32_t) + sizeof(uint32_t) + step.mask.size() * sizeof(double);
+    offsets.resize(h.levels + 1);
+    uint64_t offset = align(header_size);
+    for (uint32_t block = 0; block <= h.levels; ++block)
+      {
+      offsets[block] = offset;
+      offset = align(offset + block_size(h, block) * sizeof(double));
+      }
+
+    std::vector<char> buffer(pyramid_magic, pyramid_magic + sizeof(pyramid_magic));
+    write_value<uint32_t>(buffer, version);
+    write_value<int32_t>(buffer, (int32_t)h.s);
+    write_value<uint32_t>(buffer, h.levels);
+    write_value<uint32_t>(buffer, (uint32_t)h.custom_steps.size());
+    write_value<uint64_t>(buffer, h.n);
+    for (uint64_t o : offsets)
+      write_value<uint64_t>(buffer, o);
+    for (const auto& step : h.custom_steps)
+      {
+      write_value<int32_t>(buffer, (int32_t)step.type);
+      write_value<int32_t>(buffer, (int32_t)step.only_scale_away_from_border);
+      write_value<uint32_t>(buffer, (uint32_t)step.mask.size());
+      for (double v : step.mask)
+        write_value<double>(buffer, v);
+      }
+    return buffer;
+    }
+
+  void check(const pyramid_header& h)
+    {
+    if (h.levels > 62 || !lifting::is_multiple_of_power_of_two(h.n, h.levels) || (h.n >> h.levels) == 0)
+      throw std::runtime_error("the number of samples must be a nonzero multiple of 2^levels");
+    if (h.s < 0 || h.s > custom)
+      throw std::runtime_error("unknown lifting scheme");
+    }
+  }
+
+pyramid_file::pyramid_file(const std::string& filename, bool writable)
+  {
+  _file.open(filename, writable ? mapped_file::WRITE : mapped_file::READ);
+  const char* p = _file.data();
+  const char* end = p + _file.size();
+  if (_file.size() < sizeof(pyramid_magic) || memcmp(p, pyramid_magic, sizeof(pyramid_magic)) != 0)
+    throw std::runtime_error(filename + " is not a coefficient pyramid");
+  p += sizeof(pyramid_magic);
+  const uint32_t file_version = read_value<uint32_t>(p, end);
+  if (file_version != version)
+    throw std::runtime_error("unsupported pyramid file version");
+  _header.s = (scheme)read_value<int32_t>(p, end);
+  _header.levels = read_value<uint32_t>(p, end);
+  const uint32_t nr_of_steps = read_value<uint32_t>(p, end);
+  _header.n = read_value<uint64_t>(p, end);
+  check(_header);
+  _offsets.resize(_header.levels + 1);
+  for (auto& o : _offsets)
+    o = read_value<uint64_t>(p, end);
+  for (uint32_t i = 0; i < nr_of_steps; ++i)
+    {
+    _header.custom_steps.emplace_back();
+    _header.custom_steps.back().type = (lifting_step_type)read_value<int32_t>(p, end);
+    _header.custom_steps.back().only_scale_away_from_border = read_value<int32_t>(p, end);
+    const uint32_t mask_size = read_value<uint32_t>(p, end);
+    for (uint32_t j = 0; j < mask_size; ++j)
+      _header.custom_steps.back().mask.push_back(read_value<double>(p, end));
+    }
+  for (uint32_t block = 0; block <= _header.levels; ++block)
+    {
+    if (_offsets[block] % sizeof(double) != 0 || _offsets[block] + block_size(_header, block) * sizeof(double) > _file.size())
+      throw std::runtime_error(filename + " is truncated");
+    }
+  }
+
+pyramid_file::pyramid_file(const std::string& filename, uint64_t n, uint32_t levels, scheme s, const std::vector<lifting_step>& custom_steps)
+  {
+  _header.s = s;
+  if (s == custom)
+    _header.custom_steps = custom_steps;
+  _header.levels = levels;
+  _header.n = n;
+  check(_header);
+  auto buffer = encode_header(_header, _offsets);
+  const uint64_t file_size = _offsets.back() + block_size(_header, levels) * sizeof(double);
+  _file.open(filename, mapped_file::CREATE, file_size);
+  memcpy(_file.data(), buffer.data(), buffer.size());
+  }
+
+const_coefficient_span pyramid_file::_block(uint32_t block) const
+  {
+  const_coefficient_span span;
+  span.data = reinterpret_cast<const double*>(_file.data() + _offsets[block]);
+  span.size = block_size(_header, block);
+  return span;
+  }
+
+coefficient_span pyramid_file::_writable_block(uint32_t block)
+  {
+  if (!_file.writable())
+    throw std::runtime_error("pyramid file is opened read only");
+  coefficient_span span;
+  span.data = reinterpret_cast<double*>(_file.data() + _offsets[block]);
+  span.size = block_size(_header, block);
+  return span;
+  }
+
+const_coefficient_span pyramid_file::coarse() const
+  {
+  return _block(0);
+  }
+
+const_coefficient_span pyramid_file::details(uint32_t level) const
+  {
+  if (level >= _header.levels)
+    throw std::runtime_error("pyramid level out of range");
+  return _block(_header.levels - level);
+  }
+
+coefficient_span pyramid_file::writable_coarse()
+  {
+  return _writable_block(0);
+  }
+
+coefficient_span pyramid_file::writable_details(uint32_t level)
+  {
+  if (level >= _header.levels)
+    throw std::runtime_error("pyramid level out of range");
+  return _writable_block(_header.levels - level);
+  }
+
+void pyramid_file::prefetch(uint32_t level) const
+  {
+  const uint32_t last_block = level < _header.levels ? _header.levels - level : 0;
+  _file.will_need(_offsets[0], _offsets[last_block] + block_size(_header, last_block) * sizeof(double) - _offsets[0]);
+  }
+
+void pyramid_file::to_interleaved(double* values, uint32_t first_level) const
+  {
+  const uint32_t L = _header.levels;
+  const const_coefficient_span c = coarse();
+  for (uint64_t k = 0; k < c.size; ++k)
+    values[k << L] = c[k];
+  for (uint32_t level = 0; level < L; ++level)
+    {
+    const const_coefficient_span d = details(level);
+    if (level < first_level)
+      {
+      for (uint64_t k = 0; k < d.size; ++k)
+        values[((k << 1) + 1) << level] = 0.0;
+      }
+    else
+      {
+      for (uint64_t k = 0; k < d.size; ++k)
+        values[((k << 1) + 1) << level] = d[k];
+      }
+    }
+  }
+
+void pyramid_file::from_interleaved(const double* values)
+  {
+  const uint32_t L = _header.levels;
+  const coefficient_span c = writable_coarse();
+  for (uint64_t k = 0; k < c.size; ++k)
+    c[k] = values[k << L];
+  for (uint32_t level = 0; level < L; ++level)
+    {
+    const coefficient_span d = writable_details(level);
+    for (uint64_t k = 0; k < d.size; ++k)
+      d[k] = values[((k << 1) + 1) << level];
+    }
+  }
+
+void pyramid_file::flush()
+  {
+  _file.flush();
+  }
+
+void save_pyramid(const std::string& filename, const model& m, scheme s, const std::vector<lifting_step>& custom_steps)
+  {
+  std::vector<double> values = m.values;
+  for (int lev = 0; lev < m.levels; ++lev)
+    forward(values.data(), values.size(), lev, s, custom_steps);
+  pyramid_file f(filename, values.size(), (uint32_t)m.levels, s, custom_steps);
+  f.from_interleaved(values.data());
+  f.flush();
+  }
+
+void load_pyramid(model& m, const std::string& filename, uint32_t first_level)
+  {
+  pyramid_file f(filename);
+  f.prefetch(first_level);
+  m.levels = (int)f.levels();
+  m.values.resize(f.size());
+  f.to_interleaved(m.values.data(), first_level);
+  for (int lev = m.levels - 1; lev >= 0; --lev)
+    inverse(m.values.data(), m.values.size(), lev, f.header().s, f.header().custom_steps);
+  }
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "mapped_file.h"
+#include "model.h"
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/*
+On-disk coefficient pyramid.
+
+After 'levels' forward lifting steps on n samples the kernels leave the coefficients interleaved:
+the coarse coefficients sit at multiples of 2^levels and the details of level l at odd multiples of 2^l.
+This file stores each level contiguously, coarse first, then the details from level levels-1 down to
+the finest level 0. Every level starts on a page boundary, so reading the coarse levels of a mapped
+file only touches a few pages.
+
+Layout (native byte order):
+  header : "PIEFPYRM", uint32 version, int32 scheme, uint32 levels, uint32 number of custom steps, uint64 n,
+           uint64 offset per block (coarse, details levels-1, ..., details 0),
+           per custom step: int32 type, int32 only_scale_away_from_border, uint32 mask size, mask values
+  blocks : doubles, each block starting at its offset
+*/
+
+template <class T>
+struct basic_coefficient_span
+  {
+  T* data;
+  uint64_t size;
+
+  T* begin() const { return data; }
+  T* end() const { return data + size; }
+  T& operator[](uint64_t i) const { return data[i]; }
+  };
+
+typedef basic_coefficient_span<double> coefficient_span;
+typedef basic_coefficient_span<const double> const_coefficient_span;
+
+struct pyramid_header
+  {
+  scheme s;
+  std::vector<lifting_step> custom_steps;
+  uint32_t levels;
+  uint64_t n;
+  };
+
+class pyramid_file
+  {
+  public:
+    // maps an existing pyramid
+    pyramid_file(const std::string& filename, bool writable = false);
+    // creates a zero pyramid of 'levels' levels over n samples
+    pyramid_file(const std::string& filename, uint64_t n, uint32_t levels, scheme s, const std::vector<lifting_step>& custom_steps);
+
+    const pyramid_header& header() const { return _header; }
+    uint64_t size() const { return _header.n; }
+    uint32_t levels() const { return _header.levels; }
+
+    // views directly into the mapped file
+    const_coefficient_span coarse() const;
+    // the details of level 0 are the finest
+    const_coefficient_span details(uint32_t level) const;
+
+    // the same views for changing the coefficients, these throw unless the file was opened writable
+    coefficient_span writable_coarse();
+    coefficient_span writable_details(uint32_t level);
+
+    // hints the kernel to read the coarse blocks up to and including the details of 'level'
+    void prefetch(uint32_t level) const;
+
+    // writes the coefficients in the interleaved layout of the lifting kernels, details of levels below first_level are set to zero
+    void to_interleaved(double* values, uint32_t first_level = 0) const;
+    void from_interleaved(const double* values);
+
+    void flush();
+
+  private:
+    const_coefficient_span _block(uint32_t block) const;
+    coefficient_span _writable_block(uint32_t block);
+
+  private:
+    mapped_file _file;
+    pyramid_header _header;
+    std::vector<uint64_t> _offsets;
+  };
+
+// runs m.levels forward lifting steps on m.values and stores the result
+void save_pyramid(const std::string& filename, const model& m, scheme s, const std::vector<lifting_step>& custom_steps);
+
+// reads a pyramid and runs the inverse lifting steps, details of levels below first_level are ignored
+void load_pyramid(model& m, const std::string& filename, uint32_t first_level = 0);
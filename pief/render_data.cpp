@@ -0,0 +1,96 @@
+#include "render_data.h"
+
+#include <glew/GL/glew.h>
+#include "jtk/jtk/opengl.h"
+
+render_data::render_data() : _vao(nullptr), _vbo_array(nullptr), _vbo_capacity(0), _nr_of_vertices(0)
+  {
+
+  }
+
+render_data::~render_data()
+  {
+  delete_render_objects();
+  }
+
+void render_data::delete_render_objects()
+  {
+  if (_vao)
+    {
+    _vao->release();
+    delete _vao;
+    _vao = nullptr;
+    }
+  if (_vbo_array)
+    {
+    _vbo_array->release();
+    delete _vbo_array;
+    _vbo_array = nullptr;
+    }
+  _vbo_capacity = 0;
+  _nr_of_vertices = 0;
+  }
+
+namespace
+  {
+  void upload_render_data(render_data& r, const std::vector<float>& vertices)
+    {
+    using namespace jtk;
+    const uint64_t size = sizeof(GLfloat) * vertices.size();
+    if (!r._vao)
+      {
+      r._vao = new vertex_array_object();
+      r._vao->create();
+      gl_check_error(" _vao->create()");
+      r._vbo_array = new buffer_object(GL_ARRAY_BUFFER);
+      r._vbo_array->create();
+      gl_check_error("_vbo_array->create()");
+      r._vbo_array->set_usage_pattern(GL_DYNAMIC_DRAW);
+      }
+    r._vao->bind();
+    gl_check_error(" _vao->bind()");
+    r._vbo_array->bind();
+    gl_check_error("_vbo_array->bind()");
+    if (size > r._vbo_capacity)
+      {
+      // grow to the next power of two, so that changing the number of levels back and forth does not reallocate
+      uint64_t capacity = 1;
+      while (capacity < size)
+        capacity <<= 1;
+      r._vbo_array->allocate(nullptr, (int)capacity);
+      gl_check_error("_vbo_array->allocate()");
+      r._vbo_capacity = capacity;
+      }
+    else
+      {
+      // orphan the old storage, so that the driver does not wait for frames that still draw from it
+      glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)r._vbo_capacity, nullptr, GL_DYNAMIC_DRAW);
+      gl_check_error("glBufferData");
+      }
+    glBufferSubData(GL_ARRAY_BUFFER, 0, (GLsizeiptr)size, vertices.data());
+    gl_check_error("glBufferSubData");
+    r._nr_of_vertices = vertices.size() / 2;
+
+    r._vao->release();
+    gl_check_error("_vao->release()");
+    r._vbo_array->release();
+    gl_check_error("_vbo_array->release()");
+    }
+  }
+
+void fill_render_data(render_data& r, const model& m, const std::vector<double>& values, uint64_t columns)
+  {
+  r._vertices.clear();
+  set_render_columns(r, m, values, columns);
+  }
+
+void set_render_columns(render_data& r, const model& m, const std::vector<double>& values, uint64_t columns)
+  {
+  auto it = r._vertices.find(columns);
+  if (it == r._vertices.end())
+    {
+    it = r._vertices.emplace(columns, std::vector<float>()).first;
+    make_render_vertices(it->second, m.values, values, columns);
+    }
+  upload_render_data(r, it->second);
+  }
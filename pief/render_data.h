@@ -0,0 +1,35 @@
+#pragma once
+
+#include "model.h"
+
+#include <map>
+#include <vector>
+#include <stdint.h>
+
+namespace jtk
+  {
+  class buffer_object;
+  class vertex_array_object;
+  }
+
+/*
+The OpenGL objects of the plot of a signal, kept apart from model so that the model code builds without OpenGL.
+*/
+struct render_data
+  {
+  render_data();
+  ~render_data();
+
+  void delete_render_objects();
+
+  jtk::vertex_array_object* _vao;
+  jtk::buffer_object* _vbo_array;
+  uint64_t _vbo_capacity; // in bytes, the buffer is kept and only grows
+  uint64_t _nr_of_vertices; // in the buffer
+  std::map<uint64_t, std::vector<float>> _vertices; // per number of columns, of the values that were filled in last
+  };
+
+// uploads the plot of values, scaled to the signal m, decimated to 'columns' pixel columns (0 draws all samples)
+void fill_render_data(render_data& r, const model& m, const std::vector<double>& values, uint64_t columns = 0);
+// the same values as the last fill_render_data for another number of columns, earlier decimations are reused
+void set_render_columns(render_data& r, const model& m, const std::vector<double>& values, uint64_t columns);
@@ -0,0 +1,97 @@
+#include "roi.h"
+#include "lifting_range.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+  {
+  /*
+  TCoarse(first, last, values) copies coarse coefficients [first, last),
+  TDetails(level, first, last, values) copies the details [first, last) of a level.
+  */
+  template <class TCoarse, class TDetails>
+  void decode(double* values, uint64_t n, uint32_t levels, const std::vector<lifting_step>& steps, uint64_t first, uint64_t last, uint32_t level, TCoarse get_coarse, TDetails get_details)
+    {
+    if (level > levels)
+      throw std::runtime_error("decode level out of range");
+    if (first > last || last > (n >> level))
+      throw std::runtime_error("decode range out of range");
+    if (first == last)
+      return;
+
+    // from the target level up: the pairs each inverse level lifts, and the samples it needs from the level above
+    std::vector<std::vector<pair_range>> ranges(levels);
+    std::vector<pair_range> inputs(levels);
+    pair_range needed = { first, last };
+    for (uint32_t l = level; l < levels; ++l)
+      {
+      const pair_range target = { needed.first / 2, (needed.last + 1) / 2 };
+      ranges[l] = inverse_ranges(steps, target, (n >> l) / 2, inputs[l]);
+      needed = inputs[l];
+      }
+
+    // and back down: 'current' holds the samples [needed.first, needed.last) of level l + 1
+    std::vector<double> current((size_t)(needed.last - needed.first));
+    get_coarse(needed.first, needed.last, current.data());
+    std::vector<double> window, details;
+    for (uint32_t l = levels; l > level; --l)
+      {
+      const uint32_t lev = l - 1;
+      const pair_range& input = inputs[lev];
+      const uint64_t count = input.last - input.first;
+      details.resize((size_t)count);
+      get_details(lev, input.first, input.last, details.data());
+      window.resize((size_t)(2 * count));
+      for (uint64_t k = 0; k < count; ++k)
+        {
+        window[2 * k] = current[k];
+        window[2 * k + 1] = details[k];
+        }
+      inverse_range(window.data(), n >> lev, 0, steps, ranges[lev], 2 * input.first);
+      // the samples the next level (or the caller) needs
+      const uint64_t a = lev > level ? inputs[lev - 1].first : first;
+      const uint64_t b = lev > level ? inputs[lev - 1].last : last;
+      current.assign(window.begin() + (a - 2 * input.first), window.begin() + (b - 2 * input.first));
+      }
+    std::copy(current.begin(), current.end(), values);
+    }
+  }
+
+void decode_region(double* values, const pyramid_file& pyr, uint64_t first, uint64_t last, uint32_t level)
+  {
+  const pyramid_header& h = pyr.header();
+  const const_coefficient_span c = pyr.coarse();
+  decode(values, h.n, h.levels, get_lifting_steps(h.s, h.custom_steps), first, last, level,
+    [&](uint64_t a, uint64_t b, double* out)
+    {
+    std::copy(c.begin() + a, c.begin() + b, out);
+    },
+    [&](uint32_t l, uint64_t a, uint64_t b, double* out)
+    {
+    const const_coefficient_span d = pyr.details(l);
+    std::copy(d.begin() + a, d.begin() + b, out);
+    });
+  }
+
+std::vector<double> decode_region(const pyramid_file& pyr, uint64_t first, uint64_t last, uint32_t level)
+  {
+  std::vector<double> values(last > first ? (size_t)(last - first) : 0);
+  decode_region(values.data(), pyr, first, last, level);
+  return values;
+  }
+
+void decode_region(double* values, const double* coefficients, uint64_t n, uint32_t levels, scheme s, const std::vector<lifting_step>& custom_steps, uint64_t first, uint64_t last, uint32_t level)
+  {
+  decode(values, n, levels, get_lifting_steps(s, custom_steps), first, last, level,
+    [&](uint64_t a, uint64_t b, double* out)
+    {
+    for (uint64_t k = a; k < b; ++k)
+      *out++ = coefficients[k << levels];
+    },
+    [&](uint32_t l, uint64_t a, uint64_t b, double* out)
+    {
+    for (uint64_t k = a; k < b; ++k)
+      *out++ = coefficients[((k << 1) + 1) << l];
+    });
+  }
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "model.h"
+#include "pyramid_file.h"
+
+#include <vector>
+#include <stdint.h>
+
+/*
+Region of interest decoding.
+
+Reconstructs the samples [first, last) of the signal at resolution 'level' without running the inverse over the
+whole signal. Level 0 is the signal itself, level l holds the n >> l coarse samples after l forward levels, and
+level 'levels' is the coarse block of the pyramid. Only the dependency cone of the range is lifted, so the cost is
+of the order of (last - first) plus levels times the mask width. The result is identical to the full inverse.
+*/
+
+void decode_region(double* values, const pyramid_file& pyr, uint64_t first, uint64_t last, uint32_t level = 0);
+std::vector<double> decode_region(const pyramid_file& pyr, uint64_t first, uint64_t last, uint32_t level = 0);
+
+// the same for coefficients in the interleaved layout of the lifting kernels, as left by 'levels' calls to forward
+void decode_region(double* values, const double* coefficients, uint64_t n, uint32_t levels, scheme s, const std::vector<lifting_step>& custom_steps, uint64_t first, uint64_t last, uint32_t level = 0);
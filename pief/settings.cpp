@@ -10,12 +10,14 @@ settings read_settings(const char* filename)
   s.log_window = true; 
   s.script_window = true;
   s.controls = true;
+  s.frame_statistics = false;
   pref_file f(filename, pref_file::READ);
   f["file_open_folder"] >> s.file_open_folder;
   f["log_window"] >> s.log_window;
   f["script_window"] >> s.script_window;
   f["controls"] >> s.controls;
   f["fullscreen"] >> s.fullscreen;
+  f["frame_statistics"] >> s.frame_statistics;
   return s;
   }
 
@@ -26,5 +28,6 @@ void write_settings(const settings& s, const char* filename)
   f << "script_window" << s.script_window;
   f << "controls" << s.controls;
   f << "fullscreen" << s.fullscreen;
+  f << "frame_statistics" << s.frame_statistics;
   f.release();
   }
\ No newline at end of file
@@ -9,6 +9,7 @@ struct settings
   bool script_window;
   bool controls;
   bool fullscreen;
+  bool frame_statistics;
   };
 
 settings read_settings(const char* filename);
@@ -0,0 +1,618 @@
+#include "signal_file.h"
+#include "parallel.h"
+#include "text_signal.h"
+
+#include "../lifting/lifting.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <sstream>
+#include <stdexcept>
+
+namespace
+  {
+  const uint64_t data_alignment = 64;
+
+  uint16_t read_u16(const char* p)
+    {
+    uint16_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+    }
+
+  uint32_t read_u32(const char* p)
+    {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+    }
+
+  void write_u16(char* p, uint16_t v)
+    {
+    memcpy(p, &v, sizeof(v));
+    }
+
+  void write_u32(char* p, uint32_t v)
+    {
+    memcpy(p, &v, sizeof(v));
+    }
+
+  std::string lower_extension(const std::string& filename)
+    {
+    std::string ext = std::filesystem::path(filename).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](char c) { return (char)tolower((unsigned char)c); });
+    return ext;
+    }
+
+  template <class T>
+  sample_format format_of();
+
+  template <>
+  sample_format format_of<float>() { return sf_float32; }
+
+  template <>
+  sample_format format_of<double>() { return sf_float64; }
+
+  double read_sample(const char* p, sample_format f)
+    {
+    switch (f)
+      {
+      case sf_uint8: return ((double)(unsigned char)*p - 128.0) / 128.0;
+      case sf_int16: return (double)(int16_t)read_u16(p) / 32768.0;
+      case sf_int24:
+        {
+        const int32_t v = (int32_t)((uint32_t)(unsigned char)p[0] << 8 | (uint32_t)(unsigned char)p[1] << 16 | (uint32_t)(unsigned char)p[2] << 24) >> 8;
+        return (double)v / 8388608.0;
+        }
+      case sf_int32: return (double)(int32_t)read_u32(p) / 2147483648.0;
+      case sf_float32:
+        {
+        float v;
+        memcpy(&v, p, sizeof(v));
+        return (double)v;
+        }
+      case sf_float64:
+        {
+        double v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+        }
+      }
+    return 0.0;
+    }
+
+  // PCM is rounded and clipped to the range of the format
+  int64_t to_pcm(double v, int bits)
+    {
+    const double scale = (double)((int64_t)1 << (bits - 1));
+    const double x = std::round(v * scale);
+    return (int64_t)std::max(-scale, std::min(scale - 1.0, x));
+    }
+
+  void write_sample(char* p, double v, sample_format f)
+    {
+    switch (f)
+      {
+      case sf_uint8: *p = (char)(unsigned char)(to_pcm(v, 8) + 128); break;
+      case sf_int16: write_u16(p, (uint16_t)(int16_t)to_pcm(v, 16)); break;
+      case sf_int24:
+        {
+        const uint32_t x = (uint32_t)(int32_t)to_pcm(v, 24);
+        p[0] = (char)(x & 0xff);
+        p[1] = (char)((x >> 8) & 0xff);
+        p[2] = (char)((x >> 16) & 0xff);
+        break;
+        }
+      case sf_int32: write_u32(p, (uint32_t)(int32_t)to_pcm(v, 32)); break;
+      case sf_float32:
+        {
+        const float x = (float)v;
+        memcpy(p, &x, sizeof(x));
+        break;
+        }
+      case sf_float64: memcpy(p, &v, sizeof(v)); break;
+      }
+    }
+
+  uint64_t get_stride(const signal_layout& layout)
+    {
+    return layout.planar ? 1 : layout.channels;
+    }
+
+  uint64_t get_channel_offset(const signal_layout& layout, uint32_t channel)
+    {
+    if (channel >= layout.channels)
+      throw std::runtime_error("the signal has no channel " + std::to_string(channel));
+    return layout.planar ? channel * layout.frames : channel;
+    }
+
+  void check_layout(const signal_layout& layout, uint64_t available)
+    {
+    if (layout.channels == 0)
+      throw std::runtime_error("the signal has no channels");
+    if (layout.frames > available / sample_size(layout.format) / layout.channels)
+      throw std::runtime_error("the file is shorter than its samples");
+    }
+
+  void read_wav_header(const mapped_file& f, signal_layout& layout)
+    {
+    const char* p = f.data();
+    if (f.size() < 12 || memcmp(p, "RIFF", 4) != 0 || memcmp(p + 8, "WAVE", 4) != 0)
+      throw std::runtime_error("not a WAV file");
+    bool has_format = false;
+    uint16_t block_align = 0;
+    uint64_t pos = 12;
+    while (pos + 8 <= f.size())
+      {
+      const uint64_t size = read_u32(p + pos + 4);
+      const char* chunk = p + pos + 8;
+      if (memcmp(p + pos, "fmt ", 4) == 0)
+        {
+        if (size < 16 || pos + 8 + size > f.size())
+          throw std::runtime_error("the format chunk is too short");
+        uint16_t tag = read_u16(chunk);
+        if (tag == 0xfffe && size >= 40) // WAVE_FORMAT_EXTENSIBLE, the tag is the start of the sub format
+          tag = read_u16(chunk + 24);
+        layout.channels = read_u16(chunk + 2);
+        layout.sample_rate = read_u32(chunk + 4);
+        block_align = read_u16(chunk + 12);
+        const uint16_t bits = read_u16(chunk + 14);
+        if (tag == 1 && bits == 8)
+          layout.format = sf_uint8;
+        else if (tag == 1 && bits == 16)
+          layout.format = sf_int16;
+        else if (tag == 1 && bits == 24)
+          layout.format = sf_int24;
+        else if (tag == 1 && bits == 32)
+          layout.format = sf_int32;
+        else if (tag == 3 && bits == 32)
+          layout.format = sf_float32;
+        else if (tag == 3 && bits == 64)
+          layout.format = sf_float64;
+        else
+          throw std::runtime_error("unsupported WAV format " + std::to_string(tag) + " with " + std::to_string(bits) + " bits");
+        has_format = true;
+        }
+      else if (memcmp(p + pos, "data", 4) == 0)
+        {
+        if (!has_format)
+          throw std::runtime_error("the data chunk comes before the format chunk");
+        if (block_align != layout.channels * sample_size(layout.format))
+          throw std::runtime_error("unsupported block alignment");
+        layout.data_offset = pos + 8;
+        // streaming writers leave the size open, the data then lasts until the end of the file
+        const uint64_t data_size = std::min<uint64_t>(size, f.size() - layout.data_offset);
+        layout.frames = layout.channels ? data_size / block_align : 0;
+        return;
+        }
+      pos += 8 + size + (size & 1);
+      }
+    throw std::runtime_error("the WAV file has no data chunk");
+    }
+
+  // the value after key in the header dictionary of a .npy file
+  std::string npy_value(const std::string& header, const std::string& key)
+    {
+    const size_t k = header.find("'" + key + "'");
+    if (k == std::string::npos)
+      throw std::runtime_error("the .npy header has no " + key);
+    const size_t colon = header.find(':', k);
+    if (colon == std::string::npos)
+      throw std::runtime_error("the .npy header is invalid");
+    size_t first = header.find_first_not_of(' ', colon + 1);
+    if (first == std::string::npos)
+      throw std::runtime_error("the .npy header is invalid");
+    char close = ',';
+    if (header[first] == '(')
+      close = ')';
+    else if (header[first] == '\'')
+      {
+      close = '\'';
+      ++first;
+      }
+    const size_t last = header.find(close, first);
+    if (last == std::string::npos)
+      throw std::runtime_error("the .npy header is invalid");
+    return header.substr(first, last - first + (close == ')' ? 1 : 0));
+    }
+
+  void read_npy_header(const mapped_file& f, signal_layout& layout)
+    {
+    const char* p = f.data();
+    if (f.size() < 10 || memcmp(p, "\x93NUMPY", 6) != 0)
+      throw std::runtime_error("not a .npy file");
+    const bool version_1 = p[6] == 1;
+    const uint64_t header_offset = version_1 ? 10 : 12;
+    if (f.size() < header_offset)
+      throw std::runtime_error("the .npy header is too short");
+    const uint64_t header_size = version_1 ? read_u16(p + 8) : read_u32(p + 8);
+    if (header_offset + header_size > f.size())
+      throw std::runtime_error("the .npy header is too short");
+    const std::string header(p + header_offset, header_size);
+    layout.data_offset = header_offset + header_size;
+
+    const std::string descr = npy_value(header, "descr");
+    if (descr == "|u1" || descr == "<u1")
+      layout.format = sf_uint8;
+    else if (descr == "<i2")
+      layout.format = sf_int16;
+    else if (descr == "<i4")
+      layout.format = sf_int32;
+    else if (descr == "<f4")
+      layout.format = sf_float32;
+    else if (descr == "<f8")
+      layout.format = sf_float64;
+    else
+      throw std::runtime_error("unsupported .npy type " + descr);
+    layout.planar = npy_value(header, "fortran_order") == "True";
+
+    // (frames,) or (frames, channels)
+    std::string shape = npy_value(header, "shape");
+    std::replace(shape.begin(), shape.end(), ',', ' ');
+    std::stringstream str(shape.substr(1, shape.size() - 2));
+    std::vector<uint64_t> dimensions;
+    uint64_t d;
+    while (str >> d)
+      dimensions.push_back(d);
+    if (dimensions.empty() || dimensions.size() > 2)
+      throw std::runtime_error("a .npy signal must have one or two dimensions");
+    layout.frames = dimensions[0];
+    layout.channels = dimensions.size() == 2 ? (uint32_t)dimensions[1] : 1;
+    if (layout.channels == 1)
+      layout.planar = false;
+    }
+
+  std::string npy_descr(sample_format f)
+    {
+    switch (f)
+      {
+      case sf_uint8: return "|u1";
+      case sf_int16: return "<i2";
+      case sf_int32: return "<i4";
+      case sf_float32: return "<f4";
+      case sf_float64: return "<f8";
+      default: break;
+      }
+    throw std::runtime_error("a .npy file cannot hold 24 bit samples");
+    }
+
+  std::string make_npy_header(const signal_layout& layout)
+    {
+    std::stringstream str;
+    str << "{'descr': '" << npy_descr(layout.format) << "', 'fortran_order': " << (layout.planar ? "True" : "False") << ", 'shape': (" << layout.frames;
+    if (layout.channels > 1)
+      str << ", " << layout.channels;
+    str << ",), }";
+    std::string header = str.str();
+    // magic, version and length take 10 bytes, the header ends with a newline at a multiple of data_alignment
+    const uint64_t total = (10 + header.size() + 1 + data_alignment - 1) / data_alignment * data_alignment;
+    header.append(total - 10 - header.size() - 1, ' ');
+    header.push_back('\n');
+    return header;
+    }
+
+  // RIFF, fmt, a JUNK chunk that aligns the samples, and the header of the data chunk
+  const uint64_t wav_header_size = 64;
+
+  void write_wav_header(char* p, const signal_layout& layout, uint64_t data_size)
+    {
+    if (data_size > 0xffffffffull - wav_header_size)
+      throw std::runtime_error("the signal is too large for a WAV file");
+    const uint16_t bytes = (uint16_t)sample_size(layout.format);
+    memcpy(p, "RIFF", 4);
+    write_u32(p + 4, (uint32_t)(wav_header_size - 8 + data_size));
+    memcpy(p + 8, "WAVE", 4);
+    memcpy(p + 12, "fmt ", 4);
+    write_u32(p + 16, 16);
+    write_u16(p + 20, layout.format == sf_float32 || layout.format == sf_float64 ? 3 : 1);
+    write_u16(p + 22, (uint16_t)layout.channels);
+    write_u32(p + 24, layout.sample_rate);
+    write_u32(p + 28, layout.sample_rate * layout.channels * bytes);
+    write_u16(p + 32, (uint16_t)(layout.channels * bytes));
+    write_u16(p + 34, (uint16_t)(bytes * 8));
+    memcpy(p + 36, "JUNK", 4);
+    write_u32(p + 40, 12);
+    memset(p + 44, 0, 12);
+    memcpy(p + 56, "data", 4);
+    write_u32(p + 60, (uint32_t)data_size);
+    }
+
+  // copies the samples of all channels, converting the format when it differs
+  void copy_samples(const signal_file& in, signal_output& out)
+    {
+    const signal_layout& from = in.layout();
+    const signal_layout& to = out.layout();
+    if (from.format == to.format && from.planar == to.planar)
+      {
+      memcpy(out.data(), in.data(), from.frames * from.channels * sample_size(from.format));
+      return;
+      }
+    const uint64_t from_size = sample_size(from.format), to_size = sample_size(to.format);
+    for (uint32_t c = 0; c < from.channels; ++c)
+      {
+      const char* src = in.data() + in.channel_offset(c) * from_size;
+      char* dst = out.data() + out.channel_offset(c) * to_size;
+      for (uint64_t i = 0; i < from.frames; ++i)
+        write_sample(dst + i * out.stride() * to_size, read_sample(src + i * in.stride() * from_size, from.format), to.format);
+      }
+    }
+
+  void check_levels(const std::string& input, uint64_t frames, uint64_t levels)
+    {
+    if (!lifting::is_multiple_of_power_of_two(frames, levels) || (frames >> levels) == 0)
+      throw std::runtime_error(input + " has " + std::to_string(frames) + " frames, that is not a multiple of 2^" + std::to_string(levels));
+    }
+
+  void check_output(const std::string& output, const signal_layout& layout)
+    {
+    if (is_text_signal(output))
+      throw std::runtime_error("cannot write text signals, " + output);
+    if (layout.container == sc_raw && get_raw_sample_format(output) != layout.format)
+      throw std::runtime_error("the extension of " + output + " does not match the " + (layout.format == sf_float32 ? "float32" : "float64") + " samples");
+    }
+
+  template <class T>
+  void transform_channels(signal_output& out, uint64_t levels, scheme s, const std::vector<lifting_step>& custom_steps, bool inverse_transform)
+    {
+    // the channels are independent, every channel is transformed with the stride of the file
+    parallel_for(0, out.layout().channels, [&](uint64_t c)
+      {
+      T* sample = out.samples<T>((uint32_t)c);
+      const uint64_t n = out.layout().frames;
+      if (inverse_transform)
+        {
+        for (uint64_t lev = levels; lev > 0; --lev)
+          inverse(sample, n, lev - 1, s, custom_steps, out.stride());
+        }
+      else
+        {
+        for (uint64_t lev = 0; lev < levels; ++lev)
+          forward(sample, n, lev, s, custom_steps, out.stride());
+        }
+      });
+    }
+  }
+
+uint32_t sample_size(sample_format f)
+  {
+  switch (f)
+    {
+    case sf_uint8: return 1;
+    case sf_int16: return 2;
+    case sf_int24: return 3;
+    case sf_int32: return 4;
+    case sf_float32: return 4;
+    case sf_float64: return 8;
+    }
+  return 0;
+  }
+
+signal_container get_signal_container(const std::string& filename)
+  {
+  const std::string ext = lower_extension(filename);
+  if (ext == ".wav")
+    return sc_wav;
+  if (ext == ".npy")
+    return sc_npy;
+  return sc_raw;
+  }
+
+sample_format get_raw_sample_format(const std::string& filename)
+  {
+  const std::string ext = lower_extension(filename);
+  if (ext == ".f32")
+    return sf_float32;
+  if (ext == ".s16")
+    return sf_int16;
+  return sf_float64;
+  }
+
+signal_file::signal_file(const std::string& filename, sample_format raw_format, uint32_t raw_channels) : _file(filename, mapped_file::READ)
+  {
+  _layout.container = get_signal_container(filename);
+  try
+    {
+    switch (_layout.container)
+      {
+      case sc_wav: read_wav_header(_file, _layout); break;
+      case sc_npy: read_npy_header(_file, _layout); break;
+      case sc_raw:
+        {
+        _layout.format = raw_format;
+        _layout.channels = raw_channels;
+        if (raw_channels == 0)
+          throw std::runtime_error("the signal has no channels");
+        const uint64_t frame_size = (uint64_t)raw_channels * sample_size(raw_format);
+        if (_file.size() % frame_size != 0)
+          throw std::runtime_error("the size is not a multiple of the frame size");
+        _layout.frames = _file.size() / frame_size;
+        break;
+        }
+      }
+    check_layout(_layout, _file.size() - _layout.data_offset);
+    }
+  catch (std::runtime_error& e)
+    {
+    throw std::runtime_error(filename + ": " + e.what());
+    }
+  _file.sequential();
+  }
+
+uint64_t signal_file::stride() const
+  {
+  return get_stride(_layout);
+  }
+
+uint64_t signal_file::channel_offset(uint32_t channel) const
+  {
+  return get_channel_offset(_layout, channel);
+  }
+
+template <class T>
+const T* signal_file::samples(uint32_t channel) const
+  {
+  if (_layout.format != format_of<T>() || (uintptr_t)data() % alignof(T) != 0)
+    return nullptr;
+  return (const T*)data() + channel_offset(channel);
+  }
+
+template const float* signal_file::samples<float>(uint32_t) const;
+template const double* signal_file::samples<double>(uint32_t) const;
+
+void signal_file::read_channel(std::vector<double>& values, uint32_t channel) const
+  {
+  const uint64_t size = sample_size(_layout.format);
+  const char* p = data() + channel_offset(channel) * size;
+  values.resize(_layout.frames);
+  for (uint64_t i = 0; i < _layout.frames; ++i)
+    values[i] = read_sample(p + i * stride() * size, _layout.format);
+  }
+
+signal_output::signal_output(const std::string& filename, const signal_layout& layout) : _layout(layout)
+  {
+  if (_layout.channels == 0)
+    throw std::runtime_error("the signal has no channels");
+  const uint64_t data_size = _layout.frames * _layout.channels * sample_size(_layout.format);
+  std::string npy_header;
+  switch (_layout.container)
+    {
+    case sc_raw: _layout.data_offset = 0; _layout.planar = false; break;
+    case sc_wav: _layout.data_offset = wav_header_size; _layout.planar = false; break;
+    case sc_npy:
+      npy_header = make_npy_header(_layout);
+      _layout.data_offset = 10 + npy_header.size();
+      break;
+    }
+  if (_layout.container == sc_wav && _layout.channels > 0xffff)
+    throw std::runtime_error("too many channels for a WAV file");
+  _file.open(filename, mapped_file::CREATE, _layout.data_offset + data_size);
+  char* p = _file.data();
+  if (_layout.container == sc_wav)
+    write_wav_header(p, _layout, data_size);
+  else if (_layout.container == sc_npy)
+    {
+    memcpy(p, "\x93NUMPY", 6);
+    p[6] = 1;
+    p[7] = 0;
+    write_u16(p + 8, (uint16_t)npy_header.size());
+    memcpy(p + 10, npy_header.data(), npy_header.size());
+    }
+  }
+
+uint64_t signal_output::stride() const
+  {
+  return get_stride(_layout);
+  }
+
+uint64_t signal_output::channel_offset(uint32_t channel) const
+  {
+  return get_channel_offset(_layout, channel);
+  }
+
+template <class T>
+T* signal_output::samples(uint32_t channel)
+  {
+  if (_layout.format != format_of<T>())
+    return nullptr;
+  return (T*)data() + channel_offset(channel);
+  }
+
+template float* signal_output::samples<float>(uint32_t);
+template double* signal_output::samples<double>(uint32_t);
+
+void signal_output::write_channel(const std::vector<double>& values, uint32_t channel)
+  {
+  const uint64_t size = sample_size(_layout.format);
+  char* p = data() + channel_offset(channel) * size;
+  const uint64_t n = std::min<uint64_t>(values.size(), _layout.frames);
+  for (uint64_t i = 0; i < n; ++i)
+    write_sample(p + i * stride() * size, values[i], _layout.format);
+  }
+
+void signal_output::flush()
+  {
+  _file.flush();
+  }
+
+void write_signal(const std::string& filename, const std::vector<double>& values, sample_format f)
+  {
+  if (is_text_signal(filename))
+    throw std::runtime_error("cannot write text signals, " + filename);
+  signal_layout layout;
+  layout.container = get_signal_container(filename);
+  layout.format = layout.container == sc_raw ? get_raw_sample_format(filename) : f;
+  layout.frames = values.size();
+  signal_output out(filename, layout);
+  out.write_channel(values);
+  out.flush();
+  }
+
+void make_signal_function(model& m, const std::string& filename, uint32_t channel)
+  {
+  if (is_text_signal(filename))
+    {
+    text_signal_options options;
+    options.columns.push_back(channel);
+    const text_signal_file f(filename, options);
+    m.values.resize(f.frames());
+    f.read(m.values.data());
+    }
+  else
+    signal_file(filename, get_raw_sample_format(filename)).read_channel(m.values, channel);
+  const uint64_t n = ((uint64_t)1 << (uint64_t)m.levels);
+  m.values.resize(n, m.values.empty() ? 0.0 : m.values.back());
+  }
+
+uint64_t get_signal_frames(const std::string& filename)
+  {
+  if (is_text_signal(filename))
+    return text_signal_file(filename).frames();
+  return signal_file(filename, get_raw_sample_format(filename)).layout().frames;
+  }
+
+int get_signal_levels(const std::string& filename)
+  {
+  const uint64_t frames = get_signal_frames(filename);
+  int levels = 1;
+  while (levels < 62 && ((uint64_t)1 << levels) < frames)
+    ++levels;
+  return levels;
+  }
+
+void transform_signal_file(const std::string& input, const std::string& output, uint64_t levels, scheme s, const std::vector<lifting_step>& custom_steps, bool inverse_transform, const text_signal_options& text_options)
+  {
+  if (is_text_signal(input))
+    {
+    // parsed straight into the mapping of the output
+    const text_signal_file in(input, text_options);
+    check_levels(input, in.frames(), levels);
+    signal_layout layout;
+    layout.container = get_signal_container(output);
+    layout.channels = in.channels();
+    layout.frames = in.frames();
+    check_output(output, layout);
+    signal_output out(output, layout);
+    in.read(out.samples<double>(), out.stride());
+    transform_channels<double>(out, levels, s, custom_steps, inverse_transform);
+    out.flush();
+    return;
+    }
+  signal_file in(input, get_raw_sample_format(input));
+  check_levels(input, in.layout().frames, levels);
+  signal_layout layout = in.layout();
+  layout.container = get_signal_container(output);
+  // coefficients of PCM samples are not integers
+  if (layout.format != sf_float32)
+    layout.format = sf_float64;
+  check_output(output, layout);
+  signal_output out(output, layout);
+  copy_samples(in, out);
+  if (layout.format == sf_float32)
+    transform_channels<float>(out, levels, s, custom_steps, inverse_transform);
+  else
+    transform_channels<double>(out, levels, s, custom_steps, inverse_transform);
+  out.flush();
+  }
@@ -0,0 +1,130 @@
+#pragma once
+
+#include "mapped_file.h"
+#include "model.h"
+#include "text_signal.h"
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/*
+Signals in binary files: raw little-endian samples, PCM or IEEE float WAV, and NumPy .npy arrays.
+
+The container follows the extension: .wav and .npy files describe themselves, every other file is raw and its format
+and number of channels are given by the caller. Files are memory mapped and never read as a whole. The samples of a
+channel are the samples in the mapping, 'stride' samples apart, which is the layout that the kernels of lifting.h
+take. So when the samples are doubles or floats the transforms run directly on the mapping (see transform_signal_file),
+every other format is converted while it is read.
+
+The writers create the file at its final size, write the header and leave the samples to the caller in the mapping.
+The samples of a written file always start at a multiple of 64 bytes (a JUNK chunk in a WAV file, the padding of the
+header in a .npy file), so doubles in the mapping are aligned.
+
+Only little-endian hosts are supported, as for the raw files of out_of_core.h.
+
+Text files (see text_signal.h) are accepted as input wherever a file is read, their columns are the channels.
+*/
+
+enum sample_format
+  {
+  sf_uint8, // PCM, 128 is zero
+  sf_int16,
+  sf_int24,
+  sf_int32,
+  sf_float32,
+  sf_float64
+  };
+
+enum signal_container
+  {
+  sc_raw,
+  sc_wav,
+  sc_npy
+  };
+
+struct signal_layout
+  {
+  signal_container container = sc_raw;
+  sample_format format = sf_float64;
+  uint32_t channels = 1;
+  uint64_t frames = 0;
+  uint64_t data_offset = 0; // in bytes, from the start of the file to the first sample
+  bool planar = false; // channel after channel (a Fortran ordered .npy array) instead of interleaved frames
+  uint32_t sample_rate = 44100; // only stored in WAV files
+  };
+
+uint32_t sample_size(sample_format f);
+
+// the container that the extension of filename asks for
+signal_container get_signal_container(const std::string& filename);
+
+// the format of a raw file from its extension: .f32 is float32, .s16 is int16, anything else is float64
+sample_format get_raw_sample_format(const std::string& filename);
+
+class signal_file
+  {
+  public:
+    // raw_format and raw_channels are only used by raw files, throws std::runtime_error on a file it cannot read
+    signal_file(const std::string& filename, sample_format raw_format = sf_float64, uint32_t raw_channels = 1);
+
+    const signal_layout& layout() const { return _layout; }
+
+    // the distance in samples between two frames of a channel, and the first sample of a channel
+    uint64_t stride() const;
+    uint64_t channel_offset(uint32_t channel) const;
+
+    // the samples of a channel in the mapping, nullptr when the samples are not of type T or not aligned for T
+    template <class T>
+    const T* samples(uint32_t channel = 0) const;
+
+    // the samples of a channel as doubles, PCM is scaled to [-1, 1)
+    void read_channel(std::vector<double>& values, uint32_t channel = 0) const;
+
+    const char* data() const { return _file.data() + _layout.data_offset; }
+
+  private:
+    mapped_file _file;
+    signal_layout _layout;
+  };
+
+class signal_output
+  {
+  public:
+    // creates the file with room for all samples and writes its header, the raw container ignores planar
+    signal_output(const std::string& filename, const signal_layout& layout);
+
+    const signal_layout& layout() const { return _layout; }
+    uint64_t stride() const;
+    uint64_t channel_offset(uint32_t channel) const;
+
+    // nullptr when the samples are not of type T
+    template <class T>
+    T* samples(uint32_t channel = 0);
+
+    // converts to the format of the file, PCM is clipped
+    void write_channel(const std::vector<double>& values, uint32_t channel = 0);
+
+    char* data() { return _file.data() + _layout.data_offset; }
+    void flush();
+
+  private:
+    mapped_file _file;
+    signal_layout _layout;
+  };
+
+// writes one channel, the container follows the extension and a raw file gets the format of get_raw_sample_format
+void write_signal(const std::string& filename, const std::vector<double>& values, sample_format f = sf_float64);
+
+// m gets a channel (the column of a text file) of the file, cut or extended with its last sample to 2^m.levels samples
+void make_signal_function(model& m, const std::string& filename, uint32_t channel = 0);
+
+uint64_t get_signal_frames(const std::string& filename);
+
+// the number of levels whose 2^levels samples hold all frames of the file
+int get_signal_levels(const std::string& filename);
+
+// transforms every channel of the input over 'levels' levels into an output with the same container and layout
+// float32 and float64 samples keep their format and are transformed in the mapping of the output, PCM becomes float64
+// the frames must be a multiple of 2^levels, the columns of a text input are parsed into the mapping as float64
+void transform_signal_file(const std::string& input, const std::string& output, uint64_t levels, scheme s, const std::vector<lifting_step>& custom_steps, bool inverse_transform = false, const text_signal_options& text_options = text_signal_options());
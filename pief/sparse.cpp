@@ -0,0 +1,305 @@
+#include "sparse.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+  {
+  // appends [first, last) to sorted intervals, merging it with the last one if they are closer than 'gap'
+  void push(std::vector<pair_range>& intervals, uint64_t first, uint64_t last, uint64_t gap = 0)
+    {
+    if (!intervals.empty() && first <= intervals.back().last + gap)
+      intervals.back().last = std::max(intervals.back().last, last);
+    else
+      intervals.push_back({ first, last });
+    }
+
+  // merges two sorted interval sets
+  std::vector<pair_range> unite(const std::vector<pair_range>& a, const std::vector<pair_range>& b)
+    {
+    std::vector<pair_range> result;
+    result.reserve(a.size() + b.size());
+    auto ia = a.begin();
+    auto ib = b.begin();
+    while (ia != a.end() || ib != b.end())
+      {
+      const bool take_a = ib == b.end() || (ia != a.end() && ia->first < ib->first);
+      const pair_range& r = take_a ? *ia++ : *ib++;
+      push(result, r.first, r.last);
+      }
+    return result;
+    }
+
+  // the runs of nonzero values among values[((2k+1) << level)], in k
+  std::vector<pair_range> nonzero_details(const double* values, uint64_t n, uint32_t level)
+    {
+    std::vector<pair_range> result;
+    const uint64_t nr_of_pairs = (n >> level) / 2;
+    for (uint64_t k = 0; k < nr_of_pairs; ++k)
+      {
+      if (values[((k << 1) + 1) << level] != 0.0)
+        push(result, k, k + 1);
+      }
+    return result;
+    }
+  }
+
+std::vector<pair_range> sparse_inverse(double* values, uint64_t n, uint32_t levels, scheme s, const std::vector<lifting_step>& custom_steps)
+  {
+  std::vector<std::vector<pair_range>> support(levels + 1);
+  for (uint32_t l = 0; l < levels; ++l)
+    support[l] = nonzero_details(values, n, l);
+  for (uint64_t k = 0; k < (n >> levels); ++k)
+    {
+    if (values[k << levels] != 0.0)
+      push(support[levels], k, k + 1);
+    }
+  return sparse_inverse(values, n, levels, s, custom_steps, support);
+  }
+
+std::vector<pair_range> sparse_inverse(double* values, uint64_t n, uint32_t levels, scheme s, const std::vector<lifting_step>& custom_steps, const std::vector<std::vector<pair_range>>& support)
+  {
+  if (support.size() != (size_t)levels + 1)
+    throw std::runtime_error("the support needs the details of every level and the coarse samples");
+  for (uint32_t l = 0; l <= levels; ++l)
+    {
+    const uint64_t size = l == levels ? n >> levels : (n >> l) / 2;
+    for (size_t i = 0; i < support[l].size(); ++i)
+      {
+      if (support[l][i].last > size || (i > 0 && support[l][i].first < support[l][i - 1].last))
+        throw std::runtime_error("the support intervals must be sorted, disjoint and inside the level");
+      }
+    }
+
+  const std::vector<lifting_step> steps = get_lifting_steps(s, custom_steps);
+
+  // two intervals whose cones are closer than this are lifted together, so that the cones never overlap
+  uint64_t cone_width = 0;
+  for (const auto& step : steps)
+    {
+    int64_t left, right;
+    get_reach(step, left, right);
+    cone_width += (uint64_t)(left + right);
+    }
+
+  // the support of the coarse samples of the current level
+  std::vector<pair_range> active = support[levels];
+
+  for (uint32_t l = levels; l > 0; --l)
+    {
+    const uint32_t lev = l - 1;
+    const uint64_t nr_of_pairs = (n >> lev) / 2;
+    const std::vector<pair_range> input = unite(active, support[lev]);
+
+    // the pairs that can become nonzero, grouped so that the cones of the groups are disjoint
+    std::vector<pair_range> affected;
+    for (pair_range r : input)
+      {
+      for (size_t k = steps.size(); k > 0; --k)
+        r = spread(r, steps[k - 1], nr_of_pairs);
+      push(affected, r.first, r.last, cone_width);
+      }
+
+    // everything outside 'affected' is zero before and after this level, so lifting the groups in place is exact
+    active.clear();
+    for (const auto& r : affected)
+      {
+      pair_range cone;
+      const auto ranges = inverse_ranges(steps, r, nr_of_pairs, cone);
+      inverse_range(values, n, lev, steps, ranges);
+      push(active, 2 * r.first, 2 * r.last);
+      }
+    }
+  return active;
+  }
+
+namespace
+  {
+  struct constant_run
+    {
+    uint64_t first;
+    uint64_t last;
+    double value;
+    };
+
+  const uint64_t dense_block_pairs = 4096;
+
+  // gathers the samples of pairs [first, last) of a level and lifts them with the given ranges
+  void lift_window(std::vector<double>& window, const double* values, uint64_t n, uint32_t level, const std::vector<lifting_step>& steps, const std::vector<pair_range>& ranges, const pair_range& cone)
+    {
+    window.resize((size_t)(2 * (cone.last - cone.first)));
+    for (uint64_t p = cone.first; p < cone.last; ++p)
+      {
+      window[2 * (p - cone.first)] = values[(p << 1) << level];
+      window[2 * (p - cone.first) + 1] = values[((p << 1) + 1) << level];
+      }
+    forward_range(window.data(), n >> level, 0, steps, ranges, 2 * cone.first);
+    }
+  }
+
+void sparse_forward(double* values, uint64_t n, uint32_t levels, scheme s, const std::vector<lifting_step>& custom_steps)
+  {
+  const std::vector<lifting_step> steps = get_lifting_steps(s, custom_steps);
+
+  // the cone of one pair is [i - left, i + right], the border pairs are special (update and scale steps skip them)
+  uint64_t left = 0, right = 0, border = 1;
+  for (const auto& step : steps)
+    {
+    int64_t l, r;
+    get_reach(step, l, r);
+    left += (uint64_t)l;
+    right += (uint64_t)r;
+    if ((step.type == lst_scale_even || step.type == lst_scale_odd) && !step.mask.empty())
+      border = std::max<uint64_t>(border, (uint64_t)std::max<int64_t>(0, step.only_scale_away_from_border));
+    }
+
+  // the result of an interior pair of a run of c: lift one pair in the middle of a constant signal
+  std::vector<double> window;
+  auto lift_constant = [&](double c, double& even, double& odd)
+    {
+    const uint64_t nr_of_pairs = border + left + 1 + right + border;
+    const uint64_t i = border + left;
+    std::vector<double> constant((size_t)(2 * nr_of_pairs), c);
+    pair_range cone;
+    const auto ranges = forward_ranges(steps, { i, i + 1 }, nr_of_pairs, cone);
+    forward_range(constant.data(), 2 * nr_of_pairs, 0, steps, ranges);
+    even = constant[2 * i];
+    odd = constant[2 * i + 1];
+    };
+
+  // runs at the finest level, too short runs have no interior pairs
+  std::vector<constant_run> runs;
+  const uint64_t min_run = 2 * (left + right + 1);
+  for (uint64_t i = 0; i < n;)
+    {
+    uint64_t j = i + 1;
+    while (j < n && values[j] == values[i])
+      ++j;
+    if (j - i >= min_run)
+      runs.push_back({ i, j, values[i] });
+    i = j;
+    }
+
+  std::vector<double> dense;
+  std::vector<pair_range> segments;
+  std::vector<constant_run> interiors;
+  for (uint32_t lev = 0; lev < levels; ++lev)
+    {
+    const uint64_t nr_of_pairs = (n >> lev) / 2;
+
+    // the interior pairs of each run, whose cones stay inside the run and away from the borders
+    interiors.clear();
+    for (const auto& r : runs)
+      {
+      const uint64_t a = std::max<uint64_t>((r.first + 1) / 2, border) + left;
+      const uint64_t b = std::min<uint64_t>(r.last / 2, nr_of_pairs > border ? nr_of_pairs - border : 0);
+      if (b > a + right)
+        interiors.push_back({ a, b - right, r.value });
+      }
+
+    // lift the pairs in between, reading from the untouched level before anything is written back
+    segments.clear();
+    uint64_t previous = 0;
+    for (const auto& r : interiors)
+      {
+      if (r.first > previous)
+        segments.push_back({ previous, r.first });
+      previous = r.last;
+      }
+    if (previous < nr_of_pairs)
+      segments.push_back({ previous, nr_of_pairs });
+    dense.clear();
+    for (const auto& seg : segments)
+      {
+      for (uint64_t p0 = seg.first; p0 < seg.last; p0 += dense_block_pairs)
+        {
+        const uint64_t p1 = std::min<uint64_t>(seg.last, p0 + dense_block_pairs);
+        pair_range cone;
+        const auto ranges = forward_ranges(steps, { p0, p1 }, nr_of_pairs, cone);
+        lift_window(window, values, n, lev, steps, ranges, cone);
+        dense.insert(dense.end(), window.begin() + 2 * (p0 - cone.first), window.begin() + 2 * (p1 - cone.first));
+        }
+      }
+    auto it = dense.begin();
+    for (const auto& seg : segments)
+      {
+      for (uint64_t p = seg.first; p < seg.last; ++p)
+        {
+        values[(p << 1) << lev] = *it++;
+        values[((p << 1) + 1) << lev] = *it++;
+        }
+      }
+
+    // fill the runs, the coarse samples of a run form a run of the next level
+    runs.clear();
+    for (const auto& r : interiors)
+      {
+      double even, odd;
+      lift_constant(r.value, even, odd);
+      if (even != r.value)
+        {
+        for (uint64_t p = r.first; p < r.last; ++p)
+          values[(p << 1) << lev] = even;
+        }
+      if (odd != r.value)
+        {
+        for (uint64_t p = r.first; p < r.last; ++p)
+          values[((p << 1) + 1) << lev] = odd;
+        }
+      if (r.last - r.first >= min_run)
+        runs.push_back({ r.first, r.last, even });
+      }
+    }
+  }
+
+std::vector<double> impulse_response(uint64_t& first, uint64_t index, double value, uint64_t n, uint32_t levels, const std::vector<lifting_step>& steps)
+  {
+  // the level of the coefficient and its index among the coarse samples or the details of that level
+  uint32_t detail_level = levels;
+  uint64_t k = index >> levels;
+  for (uint32_t l = 0; l < levels; ++l)
+    {
+    if ((index >> l) & 1)
+      {
+      detail_level = l;
+      k = index >> (l + 1);
+      break;
+      }
+    }
+
+  // 'current' holds the samples [current_first, current_first + current.size()) of level l + 1, the rest is zero
+  std::vector<double> current;
+  uint64_t current_first = 0;
+  if (detail_level == levels)
+    {
+    current.push_back(value);
+    current_first = k;
+    }
+  std::vector<double> window;
+  for (uint32_t l = std::min(detail_level + 1, levels); l > 0; --l)
+    {
+    const uint32_t lev = l - 1;
+    const uint64_t nr_of_pairs = (n >> lev) / 2;
+    pair_range affected = current.empty() ? pair_range{ k, k + 1 } : pair_range{ current_first, current_first + current.size() };
+    if (lev == detail_level)
+      {
+      affected.first = std::min(affected.first, k);
+      affected.last = std::max(affected.last, k + 1);
+      }
+    for (size_t j = steps.size(); j > 0; --j)
+      affected = spread(affected, steps[j - 1], nr_of_pairs);
+
+    pair_range cone;
+    const auto ranges = inverse_ranges(steps, affected, nr_of_pairs, cone);
+    window.assign((size_t)(2 * (cone.last - cone.first)), 0.0);
+    for (uint64_t p = std::max(cone.first, current_first); p < std::min(cone.last, current_first + current.size()); ++p)
+      window[2 * (p - cone.first)] = current[p - current_first];
+    if (lev == detail_level)
+      window[2 * (k - cone.first) + 1] = value;
+    inverse_range(window.data(), n >> lev, 0, steps, ranges, 2 * cone.first);
+    current.assign(window.begin() + 2 * (affected.first - cone.first), window.begin() + 2 * (affected.last - cone.first));
+    current_first = 2 * affected.first;
+    }
+  first = current_first;
+  return current;
+  }
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "lifting_range.h"
+#include "model.h"
+
+#include <vector>
+#include <stdint.h>
+
+/*
+Transforms that skip the parts of a signal where nothing happens.
+
+sparse_inverse does the same as calling inverse for levels-1 down to 0 on coefficients in the interleaved layout,
+but keeps the support of the nonzero coefficients per level as a set of intervals. Each interval is widened by the
+reach of the steps as it moves to the finer level, and the steps only run inside the intervals; everything outside
+stays exactly zero. The first overload scans all coefficients for the nonzero ones, which is O(n). The second takes
+the support from the caller, e.g. a thresholding step that knows which coefficients it kept, and then the cost is
+proportional to the support alone.
+*/
+
+// returns the support of the reconstructed signal as sorted disjoint sample intervals
+std::vector<pair_range> sparse_inverse(double* values, uint64_t n, uint32_t levels, scheme s, const std::vector<lifting_step>& custom_steps);
+// support[l] for l < levels holds the pairs k of the nonzero details values[(2k + 1) << l] of level l, support[levels]
+// the nonzero coarse samples values[k << levels], as sorted disjoint intervals; the coefficients outside must be zero
+// throws std::runtime_error when the intervals are not sorted or reach outside their level
+std::vector<pair_range> sparse_inverse(double* values, uint64_t n, uint32_t levels, scheme s, const std::vector<lifting_step>& custom_steps, const std::vector<std::vector<pair_range>>& support);
+
+/*
+sparse_forward does the same as calling forward for levels 0 up to levels-1, for signals with long runs of zeros or
+constants. All pairs whose dependency cone lies inside a run, away from the borders, go through the same arithmetic,
+so one representative pair is lifted and its result is copied over the run. The runs are found once at the finest
+level and followed to the coarser levels; only the pairs near the run boundaries are really lifted. Zero runs stay
+zero and are not even written.
+*/
+void sparse_forward(double* values, uint64_t n, uint32_t levels, scheme s, const std::vector<lifting_step>& custom_steps);
+
+/*
+The inverse of coefficients that are all zero except coefficients[index] = value, in the interleaved layout left by
+'levels' calls to forward with the given steps (see get_lifting_steps). Only the support is lifted, level by level.
+The result holds the samples [first, first + result.size()), all other samples are zero.
+*/
+std::vector<double> impulse_response(uint64_t& first, uint64_t index, double value, uint64_t n, uint32_t levels, const std::vector<lifting_step>& steps);
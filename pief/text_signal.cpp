@@ -0,0 +1,249 @@
+#include "text_signal.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <thread>
+
+namespace
+  {
+  // smaller chunks are not worth a thread
+  const uint64_t min_chunk_size = 1 << 20;
+
+  bool is_blank(char c)
+    {
+    return c == ' ' || c == '\t';
+    }
+
+  // the end of the line that starts at p, without '\r', and the start of the next line
+  const char* line_end(const char* p, const char* end, const char*& next)
+    {
+    const char* eol = (const char*)memchr(p, '\n', (size_t)(end - p));
+    if (!eol)
+      eol = end;
+    next = eol == end ? end : eol + 1;
+    if (eol > p && eol[-1] == '\r')
+      --eol;
+    return eol;
+    }
+
+  // empty lines and comments are no frames
+  bool is_frame(const char* p, const char* end)
+    {
+    while (p < end && is_blank(*p))
+      ++p;
+    return p < end && *p != '#';
+    }
+
+  // calls f(column, first, last) for the fields of a line until f returns false
+  template <class TFunc>
+  void for_each_field(const char* p, const char* end, char delimiter, TFunc f)
+    {
+    uint32_t column = 0;
+    if (delimiter == ' ')
+      {
+      for (;;)
+        {
+        while (p < end && is_blank(*p))
+          ++p;
+        if (p == end)
+          return;
+        const char* first = p;
+        while (p < end && !is_blank(*p))
+          ++p;
+        if (!f(column++, first, p))
+          return;
+        }
+      }
+    for (;;)
+      {
+      const char* last = (const char*)memchr(p, delimiter, (size_t)(end - p));
+      if (!last)
+        last = end;
+      const char* first = p;
+      const char* field_end = last;
+      while (first < field_end && is_blank(*first))
+        ++first;
+      while (field_end > first && is_blank(field_end[-1]))
+        --field_end;
+      if (!f(column++, first, field_end) || last == end)
+        return;
+      p = last + 1;
+      }
+    }
+
+  bool parse_number(const char* first, const char* last, double& value)
+    {
+    if (first < last && *first == '+')
+      ++first;
+    if (first == last)
+      return false;
+    const std::from_chars_result r = std::from_chars(first, last, value);
+    return r.ec == std::errc() && r.ptr == last;
+    }
+
+  std::string get_extension(const std::string& filename)
+    {
+    std::string ext = std::filesystem::path(filename).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](char c) { return (char)tolower((unsigned char)c); });
+    return ext;
+    }
+
+  bool is_tsv(const std::string& filename)
+    {
+    return get_extension(filename) == ".tsv";
+    }
+
+  char find_delimiter(const char* p, const char* end)
+    {
+    // a tab is a delimiter, so that empty fields of tab separated values keep their column
+    const char candidates[] = { ',', ';', '\t' };
+    for (char c : candidates)
+      {
+      if (memchr(p, c, (size_t)(end - p)))
+        return c;
+      }
+    return ' ';
+    }
+  }
+
+text_signal_file::text_signal_file(const std::string& filename, const text_signal_options& options) : _file(filename, mapped_file::READ),
+_columns(options.columns), _delimiter(options.delimiter), _has_header(false), _missing_value(options.missing_value), _frames(0)
+  {
+  _file.sequential();
+  const char* data = _file.data();
+  const char* end = data + _file.size();
+
+  // the first frame gives the delimiter, and is a header when it has no number
+  const char* p = data;
+  const char* next = p;
+  const char* eol = p;
+  while (p < end && !is_frame(p, eol = line_end(p, end, next)))
+    p = next;
+  if (p == end)
+    return;
+  if (_delimiter == 0)
+    _delimiter = is_tsv(filename) ? '\t' : find_delimiter(p, eol);
+  bool has_number = false;
+  for_each_field(p, eol, _delimiter, [&](uint32_t, const char* first, const char* last)
+    {
+    double v;
+    has_number = parse_number(first, last, v);
+    return !has_number;
+    });
+  _has_header = !has_number;
+  if (_has_header)
+    {
+    p = next;
+    while (p < end && !is_frame(p, eol = line_end(p, end, next)))
+      p = next;
+    if (p == end)
+      return;
+    }
+  if (_columns.empty())
+    {
+    for_each_field(p, eol, _delimiter, [&](uint32_t column, const char*, const char*)
+      {
+      _columns.push_back(column);
+      return true;
+      });
+    }
+  if (_columns.empty())
+    throw std::runtime_error(filename + " has no columns");
+  _column_channel.assign(*std::max_element(_columns.begin(), _columns.end()) + 1, -1);
+  for (size_t c = 0; c < _columns.size(); ++c)
+    _column_channel[_columns[c]] = (int64_t)c;
+
+  // chunks on line boundaries, one per core
+  const uint64_t start = (uint64_t)(p - data);
+  const uint64_t bytes = _file.size() - start;
+  const uint64_t nr_of_chunks = std::max<uint64_t>(1, std::min<uint64_t>(std::thread::hardware_concurrency(), bytes / min_chunk_size));
+  uint64_t first = start;
+  for (uint64_t i = 1; i <= nr_of_chunks; ++i)
+    {
+    uint64_t last = _file.size();
+    if (i < nr_of_chunks)
+      {
+      last = std::max(first, start + bytes * i / nr_of_chunks);
+      const char* eol_chunk = last > 0 ? (const char*)memchr(data + last - 1, '\n', (size_t)(_file.size() - last + 1)) : nullptr;
+      last = eol_chunk ? (uint64_t)(eol_chunk - data) + 1 : _file.size();
+      }
+    _chunks.push_back(chunk{ first, last, 0, 0 });
+    first = last;
+    }
+
+  parallel_for(0, _chunks.size(), [&](uint64_t i)
+    {
+    chunk& c = _chunks[i];
+    const char* line = data + c.first;
+    const char* chunk_end = data + c.last;
+    const char* next_line;
+    while (line < chunk_end)
+      {
+      if (is_frame(line, line_end(line, chunk_end, next_line)))
+        ++c.frames;
+      line = next_line;
+      }
+    });
+  for (auto& c : _chunks)
+    {
+    c.first_frame = _frames;
+    _frames += c.frames;
+    }
+  }
+
+uint64_t text_signal_file::read(double* values, uint64_t stride) const
+  {
+  const char* data = _file.data();
+  const uint64_t channels = _columns.size();
+  const uint64_t max_column = _column_channel.size();
+  std::vector<uint64_t> missing(_chunks.size(), 0);
+  parallel_for(0, _chunks.size(), [&](uint64_t i)
+    {
+    const chunk& c = _chunks[i];
+    const char* line = data + c.first;
+    const char* chunk_end = data + c.last;
+    const char* next_line;
+    double* frame = values + c.first_frame * stride;
+    while (line < chunk_end)
+      {
+      const char* eol = line_end(line, chunk_end, next_line);
+      if (is_frame(line, eol))
+        {
+        uint64_t parsed = 0;
+        for (uint64_t ch = 0; ch < channels; ++ch)
+          frame[ch] = _missing_value;
+        for_each_field(line, eol, _delimiter, [&](uint32_t column, const char* first, const char* last)
+          {
+          if (column >= max_column)
+            return false;
+          const int64_t ch = _column_channel[column];
+          double v;
+          if (ch >= 0 && parse_number(first, last, v))
+            {
+            frame[ch] = v;
+            ++parsed;
+            }
+          return true;
+          });
+        missing[i] += channels - parsed;
+        frame += stride;
+        }
+      line = next_line;
+      }
+    });
+  uint64_t total = 0;
+  for (uint64_t m : missing)
+    total += m;
+  return total;
+  }
+
+bool is_text_signal(const std::string& filename)
+  {
+  const std::string ext = get_extension(filename);
+  return ext == ".csv" || ext == ".tsv" || ext == ".txt";
+  }
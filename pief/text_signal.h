@@ -0,0 +1,64 @@
+#pragma once
+
+#include "mapped_file.h"
+
+#include <limits>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/*
+Signals in text files: CSV, semicolon or tab separated, or columns separated by white space. A file with a tab in its
+first frame is read as tab separated, so that an empty field keeps its column; give ' ' as delimiter for columns
+aligned with tabs and spaces.
+
+Every line is a frame and the selected columns are its channels. Empty lines and lines that start with '#' are
+skipped, and so is a first line that is not numeric (a header). A field that is empty, not a number, or missing
+because the line is short, gets the missing value.
+
+The file is memory mapped and split in one chunk per core on line boundaries. A first parallel pass counts the
+frames of every chunk, so that the destination can be sized once, and a second pass parses the chunks with
+std::from_chars straight into their part of the destination.
+*/
+
+struct text_signal_options
+  {
+  std::vector<uint32_t> columns; // zero based, all columns of the first frame when empty
+  char delimiter = 0; // ',', ';', '\t' or ' ' (any white space), when 0 '\t' for .tsv files, else the first of ',', ';' and '\t' in the first frame, else ' '
+  double missing_value = std::numeric_limits<double>::quiet_NaN();
+  };
+
+class text_signal_file
+  {
+  public:
+    // maps the file and counts its frames, throws std::runtime_error on a file it cannot read
+    text_signal_file(const std::string& filename, const text_signal_options& options = text_signal_options());
+
+    uint32_t channels() const { return (uint32_t)_columns.size(); }
+    uint64_t frames() const { return _frames; }
+    char delimiter() const { return _delimiter; }
+    bool has_header() const { return _has_header; }
+
+    // parses frames() frames, frame i goes to values[i * stride + c] for channel c, returns the number of missing values
+    uint64_t read(double* values, uint64_t stride) const;
+    uint64_t read(double* values) const { return read(values, channels()); }
+
+  private:
+    struct chunk
+      {
+      uint64_t first, last; // bytes in the mapping
+      uint64_t first_frame, frames;
+      };
+
+    mapped_file _file;
+    std::vector<uint32_t> _columns;
+    std::vector<int64_t> _column_channel; // the channel of a column, or -1
+    char _delimiter;
+    bool _has_header;
+    double _missing_value;
+    std::vector<chunk> _chunks;
+    uint64_t _frames;
+  };
+
+// .csv, .tsv and .txt files
+bool is_text_signal(const std::string& filename);
@@ -20,14 +20,48 @@
 #include <ctime>
 #include <iomanip>
 #include <cmath>
+#include <filesystem>
 
+#include "app_log.h"
+#include "batch_analysis.h"
 #include "logging.h"
+#include "optimizer.h"
+#include "signal_file.h"
 
 #define V_W 800
 #define V_H 450
 #define V_X 50
 #define V_Y 50
 
+#if defined(_WIN32)
+#include <windows.h>
+#endif
+
+namespace
+  {
+  const int frames_after_event = 3;
+  const int busy_timeout = 16; // milliseconds, while a worker runs
+  const int idle_timeout = 500; // milliseconds
+
+  // cpu time of the process in seconds
+  double process_cpu_seconds()
+    {
+#if defined(_WIN32)
+    FILETIME creation_time, exit_time, kernel_time, user_time;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation_time, &exit_time, &kernel_time, &user_time))
+      return 0.0;
+    ULARGE_INTEGER kernel, user;
+    kernel.LowPart = kernel_time.dwLowDateTime;
+    kernel.HighPart = kernel_time.dwHighDateTime;
+    user.LowPart = user_time.dwLowDateTime;
+    user.HighPart = user_time.dwHighDateTime;
+    return (double)(kernel.QuadPart + user.QuadPart) * 1e-7;
+#else
+    return (double)std::clock() / (double)CLOCKS_PER_SEC;
+#endif
+    }
+  }
+
 view::view() : _w(1600), _h(900), _quit(false),
 _vbo_array_blit(nullptr), _vbo_index_blit(nullptr), _vao_blit(nullptr),
 _program(nullptr), _program_blit(nullptr), _viewport_w(V_W), _viewport_h(V_H), _fbo(nullptr),
@@ -100,6 +134,19 @@ _viewport_pos_x(V_X), _viewport_pos_y(V_Y)
   _threshold = 0.01;
   _operation = 0;
   _smooth_level = 2;
+  _optimize_taps = 6;
+  _vanishing_moments = 2;
+  _signal_version = 0;
+  _component_version = 0;
+  _frames_to_draw = frames_after_event;
+  _plot_changed = true;
+  _statistics_start = std::chrono::steady_clock::now();
+  _statistics_cpu_start = process_cpu_seconds();
+  _statistics_frame_seconds = 0.0;
+  _statistics_frames = 0;
+  _frame_ms = 0.0;
+  _frames_per_second = 0.0;
+  _cpu_usage = 0.0;
   _wavelet_rules = "//four point scheme\n\npredict;\n-1/16; 9/16; 9/16; -1/16;\n\nupdate;\n0.25; 0.25;";
   _prepare_render();
   }
@@ -235,6 +282,11 @@ void main()
   _program_blit->release();
   _vbo_array_blit->release();
   _vbo_index_blit->release();
+
+  // the plot is decimated to the width of the viewport
+  if (_plot._vao)
+    set_render_columns(_plot, _m, _component, _viewport_w);
+  _plot_changed = true;
   }
 
 void view::_setup_gl_objects()
@@ -321,10 +373,13 @@ void view::_destroy_blit_gl_objects()
   _fbo = nullptr;
   }
 
-void view::_poll_for_events()
+bool view::_poll_for_events(int timeout)
   {
   SDL_Event event;
-  while (SDL_PollEvent(&event))
+  // waits at most timeout milliseconds for the first event, then handles all events in the queue
+  bool has_event = timeout > 0 ? SDL_WaitEventTimeout(&event, timeout) != 0 : SDL_PollEvent(&event) != 0;
+  const bool has_events = has_event;
+  while (has_event)
     {
     ImGui_ImplSDL2_ProcessEvent(&event);
     switch (event.type)
@@ -402,7 +457,9 @@ void view::_poll_for_events()
       break;
       }
       }
+    has_event = SDL_PollEvent(&event) != 0;
     }
+  return has_events;
   }
 
 void view::_imgui_ui()
@@ -426,6 +483,9 @@ void view::_imgui_ui()
   bool open = true;
   static bool open_script = false;
   static bool save_script = false;
+  static bool analyze_folder = false;
+  static bool load_signal = false;
+  static bool save_signal = false;
   if (ImGui::Begin("Pief", &open, window_flags))
     {
     if (!open)
@@ -442,6 +502,18 @@ void view::_imgui_ui()
           {
           save_script = true;
           }
+        if (ImGui::MenuItem("Load signal"))
+          {
+          load_signal = true;
+          }
+        if (ImGui::MenuItem("Save signal"))
+          {
+          save_signal = true;
+          }
+        if (ImGui::MenuItem("Analyze folder"))
+          {
+          analyze_folder = true;
+          }
         if (ImGui::MenuItem("Exit"))
           {
           _quit = true;
@@ -459,8 +531,11 @@ void view::_imgui_ui()
         ImGui::MenuItem("Controls", NULL, &_settings.controls);
         ImGui::MenuItem("Log window", NULL, &_settings.log_window);
         ImGui::MenuItem("Script window", NULL, &_settings.script_window);
+        ImGui::MenuItem("Frame statistics", NULL, &_settings.frame_statistics);
         ImGui::EndMenu();
         }
+      if (_settings.frame_statistics)
+        ImGui::Text("    frame %.2f ms    %.0f frames/s    cpu %.1f%%", _frame_ms, _frames_per_second, _cpu_usage);
       ImGui::EndMenuBar();
       }
     ImGui::End();
@@ -490,6 +565,61 @@ void view::_imgui_ui()
     t.close();
     }
 
+  static ImGuiFs::Dialog load_signal_dlg(false, true, true);
+  const char* loadSignalChosenPath = load_signal_dlg.chooseFileDialog(load_signal, _settings.file_open_folder.c_str(), ".wav;.npy;.raw;.f32;.s16;.csv;.tsv;.txt", "Load signal", ImVec2(-1, -1), ImVec2(50, 50));
+  load_signal = false;
+  if (strlen(loadSignalChosenPath) > 0)
+    {
+    _settings.file_open_folder = load_signal_dlg.getLastDirectory();
+    try
+      {
+      // enough levels for the whole signal, within what the viewer can show
+      _m.levels = std::min(get_signal_levels(loadSignalChosenPath), 20);
+      _signal_filename = loadSignalChosenPath;
+      _function_type = 5;
+      if (_level > _m.levels)
+        _level = _m.levels;
+      _prepare_render();
+      }
+    catch (std::exception& e)
+      {
+      Logging::Error() << e.what() << "\n";
+      }
+    }
+
+  static ImGuiFs::Dialog save_signal_dlg(false, true, true);
+  const char* saveSignalChosenPath = save_signal_dlg.saveFileDialog(save_signal, _settings.file_open_folder.c_str(), 0, ".wav;.npy;.raw;.f32;.s16", "Save signal");
+  save_signal = false;
+  if (strlen(saveSignalChosenPath) > 0)
+    {
+    _settings.file_open_folder = save_signal_dlg.getLastDirectory();
+    try
+      {
+      write_signal(saveSignalChosenPath, _m.values);
+      }
+    catch (std::exception& e)
+      {
+      Logging::Error() << e.what() << "\n";
+      }
+    }
+
+  static ImGuiFs::Dialog analyze_folder_dlg(false, true, true);
+  const char* analyzeFolderChosenPath = analyze_folder_dlg.chooseFolderDialog(analyze_folder, _settings.file_open_folder.c_str(), "Analyze folder");
+  analyze_folder = false;
+  if (strlen(analyzeFolderChosenPath) > 0)
+    {
+    const std::string folder = analyzeFolderChosenPath;
+    _tool_worker.submit([folder](job_state& state) -> worker::completion
+      {
+      const std::vector<batch_scheme> schemes = read_scheme_folder(folder);
+      const std::vector<std::string> records = analyze_batch(schemes, [&state](double progress) { state.report(progress); });
+      const std::string filename = (std::filesystem::path(folder) / "analysis.jsonl").string();
+      write_batch_report(filename, records);
+      Logging::GetInstance() << "Analyzed " << schemes.size() << " scripts, the report is in " << filename << "\n";
+      return worker::completion();
+      });
+    }
+
   if (_settings.log_window)
     _log_window();
 
@@ -518,71 +648,61 @@ void view::_script_window()
 
 void view::_prepare_render()
   {
-  std::vector<lifting_step> custom_steps;
-  if ((scheme)_lifting_scheme == custom)
+  pipeline_settings ps;
+  ps.levels = _m.levels;
+  ps.s = (scheme)_lifting_scheme;
+  ps.script = _wavelet_rules;
+  ps.function_type = _function_type;
+  ps.test_function = _test_function;
+  ps.signal_filename = _signal_filename;
+  ps.operation = _operation;
+  ps.threshold = _threshold;
+  ps.smooth_level = _smooth_level;
+  ps.space = _space;
+  ps.level = _level;
+  // the pipeline runs on the render worker, only the stages whose inputs changed are computed again
+  _render_worker.submit([this, ps](job_state& state) -> worker::completion
     {
-    custom_steps = parse(_wavelet_rules);
-    if (custom_steps.empty())
+    _pipeline.update(ps, [&state](double progress) { state.report(progress); });
+    // the results go in back buffers that the window swaps in
+    const bool new_signal = _signal_version != _pipeline.signal_version();
+    const bool new_component = _component_version != _pipeline.component_version();
+    auto signal = std::make_shared<std::vector<double>>();
+    auto component = std::make_shared<std::vector<double>>();
+    if (new_signal)
+      *signal = _pipeline.signal().values;
+    if (new_component)
+      *component = _pipeline.component();
+    _signal_version = _pipeline.signal_version();
+    _component_version = _pipeline.component_version();
+    const scheme active = _pipeline.active_scheme();
+    return [this, ps, active, signal, component, new_signal, new_component]()
       {
-      _lifting_scheme = 0;
-      }
-    }
-  switch (_function_type)
-    {
-    case 0: make_scaling_function(_m, (scheme)_lifting_scheme, custom_steps); break;
-    case 1: make_wavelet_function(_m, (scheme)_lifting_scheme, custom_steps); break;
-    case 2: make_biorthogonal_scaling_function(_m, (scheme)_lifting_scheme, custom_steps); break;
-    case 3: make_biorthogonal_wavelet_function(_m, (scheme)_lifting_scheme, custom_steps); break;
-    case 4: make_test_function(_m, _test_function); break;
-    }  
-  if (_operation == 1)
-    {
-    auto values_copy = _m.values;
-    double ratio = compress(_m, _threshold, (scheme)_lifting_scheme, custom_steps);
-    Logging::GetInstance() << "Compression ratio equals " << ratio*100.0 << "%%\n";
-    double max_error = 0.0;
-    double l2_error = 0.0;
-    for (uint64_t i = 0; i < values_copy.size(); ++i)
-      {
-      max_error = std::max<double>(max_error, std::abs(values_copy[i] - _m.values[i]));
-      l2_error += pow(values_copy[i] - _m.values[i], 2.0);
-      }
-    l2_error = std::sqrt(l2_error);
-    Logging::GetInstance() << "l_inf error: " << max_error << "\n";
-    Logging::GetInstance() << "l2 error: " << l2_error << "\n";
-    }
-  else if (_operation == 2)
-    {
-    auto values_copy = _m.values;
-    smooth(_m, _threshold, _smooth_level, (scheme)_lifting_scheme, custom_steps);
-    double max_error = 0.0;
-    double l2_error = 0.0;
-    for (uint64_t i = 0; i < values_copy.size(); ++i)
-      {
-      max_error = std::max<double>(max_error, std::abs(values_copy[i] - _m.values[i]));
-      l2_error += pow(values_copy[i] - _m.values[i], 2.0);
-      }
-    l2_error = std::sqrt(l2_error);
-    Logging::GetInstance() << "l_inf error: " << max_error << "\n";
-    Logging::GetInstance() << "l2 error: " << l2_error << "\n";
-    }
-  double volume = std::numeric_limits<double>::infinity();
-  if (_space == 0 && _level == _m.levels)
-    {
-    fill_render_data(_m, _m.values);
-    volume = compute_volume(_m.values);
-    }
-  else
+      // a custom scheme without steps falls back, unless another scheme was chosen in the meantime
+      if ((scheme)_lifting_scheme == ps.s)
+        _lifting_scheme = (int)active;
+      if (new_signal)
+        _m.values.swap(*signal);
+      if (new_component)
+        {
+        _component.swap(*component);
+        fill_render_data(_plot, _m, _component, _viewport_w);
+        _plot_changed = true;
+        }
+      };
+    });
+  }
+
+void view::_progress_bars()
+  {
+  if (_render_worker.busy())
+    ImGui::ProgressBar((float)_render_worker.progress(), ImVec2(-1.0f, 0.0f), "Computing");
+  if (_tool_worker.busy())
     {
-    std::vector<double> values(_m.values.size(), 0.0);
-    if (_space == 0)
-      get_spline_component(values, _m, _level, (scheme)_lifting_scheme, custom_steps);
-    else
-      get_wavelet_component(values, _m, _level, (scheme)_lifting_scheme, custom_steps);
-    fill_render_data(_m, values);
-    volume = compute_volume(values);
+    ImGui::ProgressBar((float)_tool_worker.progress(), ImVec2(-1.0f, 0.0f), "Analyzing");
+    if (ImGui::Button("Cancel"))
+      _tool_worker.cancel();
     }
-  Logging::GetInstance() << "Volume equals " << volume << "\n";
   }
 
 void view::_control_window()
@@ -618,8 +738,9 @@ void view::_control_window()
     {
     _prepare_render();
     }
-  const char* function_type_arr[] = { "scaling", "wavelet", "biorthogonal scaling", "biorthogonal wavelet", "test function" };
-  if (ImGui::Combo("Function type", &_function_type, function_type_arr, IM_ARRAYSIZE(function_type_arr)))
+  const char* function_type_arr[] = { "scaling", "wavelet", "biorthogonal scaling", "biorthogonal wavelet", "test function", "signal file" };
+  // the signal file is chosen with File > Load signal
+  if (ImGui::Combo("Function type", &_function_type, function_type_arr, _signal_filename.empty() ? 5 : 6))
     {
     _prepare_render();
     }
@@ -632,6 +753,8 @@ void view::_control_window()
       _prepare_render();
       }
     }
+  if (_function_type == 5)
+    ImGui::Text("%s", std::filesystem::path(_signal_filename).filename().string().c_str());
 
   ImGui::Dummy(ImVec2(0.0f, 20.0f));
 
@@ -691,41 +814,106 @@ void view::_control_window()
 
   if (ImGui::Button("Analyze"))
     {
-    std::vector<lifting_step> custom_steps;
-    if ((scheme)_lifting_scheme == custom)
+    const scheme s = (scheme)_lifting_scheme;
+    const std::string rules = _wavelet_rules;
+    _tool_worker.submit([s, rules](job_state&) -> worker::completion
       {
-      custom_steps = parse(_wavelet_rules); // this method calls analyze
-      if (custom_steps.empty())
-        {
-        _lifting_scheme = 0;
-        }
-      }
-    else
-      analyze((scheme)_lifting_scheme, custom_steps);
+      if (s == custom)
+        parse(rules); // this method calls analyze
+      else
+        analyze(s, std::vector<lifting_step>());
+      return worker::completion();
+      });
     }
   ImGui::SameLine(0, 50);
   if (ImGui::Button("Construct (custom)"))
-    {    
-    std::vector<lifting_step> custom_steps;
-    custom_steps = parse(_wavelet_rules);
-    if (!custom_steps.empty())
+    {
+    const std::string rules = _wavelet_rules;
+    _tool_worker.submit([this, rules](job_state& state) -> worker::completion
       {
-      _lifting_scheme = (int)custom;
+      std::vector<lifting_step> custom_steps = parse(rules);
+      if (custom_steps.empty())
+        return worker::completion();
       double sob_scaling_dual, sob_scaling;
-      construct_stable_wavelet(custom_steps, sob_scaling, sob_scaling_dual);
+      construct_stable_wavelet(custom_steps, sob_scaling, sob_scaling_dual, [&state](double progress) { state.report(progress); });
       Logging::GetInstance() << "Add update step: " << custom_steps.back().mask[0] << ", " << custom_steps.back().mask[1] << ", " << custom_steps.back().mask[2] << ", " << custom_steps.back().mask[3] << "\n";
       Logging::GetInstance() << "Riesz basis for ]" << -sob_scaling_dual << ", " << sob_scaling << "[\n";
 
-      std::stringstream str;
-      str << _wavelet_rules;
-      str << "\n\n";
-      str << "update;\n";
-      str << std::setprecision(20);
-      str << custom_steps.back().mask[0] << "; " << custom_steps.back().mask[1] << "; " << custom_steps.back().mask[2] << "; " << custom_steps.back().mask[3] << ";\n";
-      _wavelet_rules = str.str();
-      _prepare_render();
-      }
+      const std::string new_rules = rules + "\n\n" + to_script(custom_steps.back());
+      return [this, new_rules]()
+        {
+        _wavelet_rules = new_rules;
+        _lifting_scheme = (int)custom;
+        _prepare_render();
+        };
+      });
+    }
+  if (ImGui::Button("Optimize (custom)"))
+    {
+    const std::string rules = _wavelet_rules;
+    const int taps = _optimize_taps;
+    _tool_worker.submit([this, rules, taps](job_state& state) -> worker::completion
+      {
+      std::vector<lifting_step> custom_steps = parse(rules);
+      if (custom_steps.empty())
+        return worker::completion();
+      std::vector<free_step> free_steps(1);
+      free_steps[0].type = lst_update;
+      free_steps[0].taps = taps;
+      optimized_scheme result = optimize_scheme(custom_steps, free_steps, [&state](double progress) { state.report(progress); });
+      Logging::GetInstance() << "Optimized after " << result.evaluations << " evaluations\n";
+      Logging::GetInstance() << "Riesz basis for ]" << -result.sob_dual << ", " << result.sob << "[\n";
+
+      const std::string new_rules = rules + "\n\n" + result.script;
+      return [this, new_rules]()
+        {
+        _wavelet_rules = new_rules;
+        _lifting_scheme = (int)custom;
+        _prepare_render();
+        };
+      });
+    }
+  ImGui::SameLine(0, 50);
+  ImGui::PushItemWidth(100);
+  if (ImGui::InputInt("Update taps", &_optimize_taps, 2))
+    {
+    if (_optimize_taps < 2)
+      _optimize_taps = 2;
+    if (_optimize_taps % 2)
+      ++_optimize_taps;
     }
+  ImGui::PopItemWidth();
+  if (ImGui::Button("Vanishing moments (custom)"))
+    {
+    const std::string rules = _wavelet_rules;
+    const int vanishing_moments = _vanishing_moments;
+    _tool_worker.submit([this, rules, vanishing_moments](job_state&) -> worker::completion
+      {
+      std::vector<lifting_step> custom_steps = parse(rules);
+      if (custom_steps.empty())
+        return worker::completion();
+      custom_steps.push_back(make_vanishing_moment_update(custom_steps, vanishing_moments));
+      double sob_scaling_dual, sob_scaling;
+      compute_scheme_smoothness(custom_steps, sob_scaling, sob_scaling_dual);
+      Logging::GetInstance() << "Riesz basis for ]" << -sob_scaling_dual << ", " << sob_scaling << "[\n";
+
+      const std::string new_rules = rules + "\n\n" + to_script(custom_steps.back());
+      return [this, new_rules]()
+        {
+        _wavelet_rules = new_rules;
+        _lifting_scheme = (int)custom;
+        _prepare_render();
+        };
+      });
+    }
+  ImGui::SameLine(0, 50);
+  ImGui::PushItemWidth(100);
+  if (ImGui::InputInt("Moments", &_vanishing_moments))
+    {
+    if (_vanishing_moments < 1)
+      _vanishing_moments = 1;
+    }
+  ImGui::PopItemWidth();
 
   ImGui::Dummy(ImVec2(0.0f, 70.0f));
 
@@ -734,6 +922,8 @@ void view::_control_window()
     _lifting_scheme = (int)custom;
     _prepare_render();
     }
+
+  _progress_bars();
   
   ImGui::End();
   }
@@ -754,46 +944,90 @@ void view::_log_window()
   }
 
 
+void view::_update_frame_statistics(double frame_seconds)
+  {
+  ++_statistics_frames;
+  _statistics_frame_seconds += frame_seconds;
+  const auto now = std::chrono::steady_clock::now();
+  const double elapsed = std::chrono::duration<double>(now - _statistics_start).count();
+  if (elapsed < 1.0)
+    return;
+  const double cpu = process_cpu_seconds();
+  _frame_ms = _statistics_frame_seconds / _statistics_frames * 1000.0;
+  _frames_per_second = _statistics_frames / elapsed;
+  _cpu_usage = (cpu - _statistics_cpu_start) / elapsed * 100.0;
+  _statistics_start = now;
+  _statistics_cpu_start = cpu;
+  _statistics_frame_seconds = 0.0;
+  _statistics_frames = 0;
+  }
+
 void view::loop()
   {
   using namespace jtk;
   while (!_quit)
     {
-    _poll_for_events();
+    // sleep until something happens, but keep drawing while frames are pending and poll the workers while they run
+    const bool busy = _render_worker.busy() || _tool_worker.busy();
+    int timeout = _frames_to_draw > 0 ? 0 : (busy ? busy_timeout : idle_timeout);
+    const bool has_events = _poll_for_events(timeout);
+
+    // results of the workers are handed over here, where the OpenGL context is current
+    const bool has_results = _render_worker.finish_jobs() | _tool_worker.finish_jobs();
+
+    // imgui needs a few frames to settle after input (hovering, opening popups)
+    if (has_events || has_results)
+      _frames_to_draw = frames_after_event;
+    // progress bars, new log lines, a blinking text cursor and the statistics are drawn at the timeout rate
+    else if (_frames_to_draw == 0 && (busy || Logging::GetInstance().has_messages() || ImGui::GetIO().WantTextInput || _settings.frame_statistics))
+      _frames_to_draw = 1;
+    if (_frames_to_draw == 0)
+      continue;
+    --_frames_to_draw;
+    const auto frame_start = std::chrono::steady_clock::now();
 
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    _fbo->bind(1);
-    gl_check_error("_fbo->bind()");
-    glViewport(0, 0, _viewport_w, _viewport_h);
-    glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);     
-
-    _m._vao->bind();
-    gl_check_error("_vao->bind()");
-    _m._vbo_array->bind();
-    gl_check_error("_vbo_array->bind()");
+    // the plot is kept in the frame buffer object and only drawn when it changed
+    if (_plot_changed)
+      {
+      _fbo->bind(1);
+      gl_check_error("_fbo->bind()");
+      glViewport(0, 0, _viewport_w, _viewport_h);
+      glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);     
+
+      // nothing to draw until the render worker delivered the first result
+      if (_plot._vao)
+        {
+        _plot._vao->bind();
+        gl_check_error("_vao->bind()");
+        _plot._vbo_array->bind();
+        gl_check_error("_vbo_array->bind()");
 
-    _program->bind();
-    gl_check_error("_program->bind()");
+        _program->bind();
+        gl_check_error("_program->bind()");
 
-    _program->enable_attribute_array(0);
-    gl_check_error("_program->enable_attribute_array(0)");
-    _program->set_attribute_buffer(0, GL_FLOAT, 0, 2, sizeof(GLfloat) * 2); // x y
-    gl_check_error("_program->set_attribute_buffer(0, GL_FLOAT, 0, 2, sizeof(GLfloat) * 2)");
+        _program->enable_attribute_array(0);
+        gl_check_error("_program->enable_attribute_array(0)");
+        _program->set_attribute_buffer(0, GL_FLOAT, 0, 2, sizeof(GLfloat) * 2); // x y
+        gl_check_error("_program->set_attribute_buffer(0, GL_FLOAT, 0, 2, sizeof(GLfloat) * 2)");
 
-    glDrawArrays(GL_LINE_STRIP, 0, (GLsizei)(_m.values.size()));
-    gl_check_error("glDrawArrays");
+        glDrawArrays(GL_LINE_STRIP, 0, (GLsizei)(_plot._nr_of_vertices));
+        gl_check_error("glDrawArrays");
     
-    _program->release();
-    gl_check_error("_program->release()");
-    _m._vbo_array->release();
-    gl_check_error("_m._vbo_array->release()");
-    _m._vao->release();
-    gl_check_error("_m._vao->release()");
-    _fbo->release();
-    gl_check_error("_fbo->release()");
+        _program->release();
+        gl_check_error("_program->release()");
+        _plot._vbo_array->release();
+        gl_check_error("_plot._vbo_array->release()");
+        _plot._vao->release();
+        gl_check_error("_plot._vao->release()");
+        }
+      _fbo->release();
+      gl_check_error("_fbo->release()");
+      _plot_changed = false;
+      }
 
     glViewport(0, 0, _w, _h);
 
@@ -834,6 +1068,7 @@ void view::loop()
 
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
+    _update_frame_statistics(std::chrono::duration<double>(std::chrono::steady_clock::now() - frame_start).count());
 
     SDL_GL_SwapWindow(_window);
 
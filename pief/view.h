@@ -8,6 +8,9 @@
 
 #include "settings.h"
 #include "model.h"
+#include "render_data.h"
+#include "pipeline.h"
+#include "worker.h"
 #include "mouse_data.h"
 
 namespace jtk
@@ -29,7 +32,8 @@ class view
     void loop();
 
   private:
-    void _poll_for_events();
+    bool _poll_for_events(int timeout);
+    void _update_frame_statistics(double frame_seconds);
     void _imgui_ui();
     void _setup_blit_gl_objects(bool fullscreen);
     void _setup_gl_objects();
@@ -39,6 +43,7 @@ class view
     void _destroy_gl_objects();
     void _destroy_blit_gl_objects();
     void _prepare_render();
+    void _progress_bars();
 
   private:
     SDL_Window* _window;    
@@ -53,13 +58,28 @@ class view
     jtk::shader_program* _program_blit;
     mouse_data _md;
     model _m;
+    render_data _plot; // of _component
+    std::vector<double> _component; // in the plot, kept to decimate it again when the viewport changes
+    pipeline _pipeline; // only used by the jobs of _render_worker
+    uint64_t _signal_version, _component_version; // of the pipeline results handed to the window, also only used by those jobs
     int _lifting_scheme;
     int _function_type;
     int _test_function;
+    std::string _signal_filename; // of the signal file function type
     int _space; // 0 is spline space, 1 is wavelet spline
     int _level;
     double _threshold;
     int _operation;
     int _smooth_level;
     std::string _wavelet_rules;
+    int _optimize_taps; // of the update that Optimize appends
+    int _vanishing_moments; // of the update that Vanishing moments appends
+    int _frames_to_draw; // frames to draw before waiting for events again
+    bool _plot_changed; // the offscreen plot has to be drawn again
+    std::chrono::steady_clock::time_point _statistics_start;
+    double _statistics_cpu_start, _statistics_frame_seconds;
+    uint32_t _statistics_frames;
+    double _frame_ms, _frames_per_second, _cpu_usage; // over the last second
+    worker _tool_worker; // analysis and construction
+    worker _render_worker; // _pipeline, last so that it stops first
   };
\ No newline at end of file
@@ -0,0 +1,103 @@
+#include "worker.h"
+#include "logging.h"
+
+#include <exception>
+
+worker::worker() : _stop(false)
+  {
+  _thread = std::thread([this]() { _run(); });
+  }
+
+worker::~worker()
+  {
+    {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stop = true;
+    _waiting = job();
+    if (_running)
+      _running->cancel();
+    }
+  _wake.notify_one();
+  _thread.join();
+  }
+
+void worker::submit(job j)
+  {
+    {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _waiting = std::move(j);
+    if (_running)
+      _running->cancel();
+    }
+  _wake.notify_one();
+  }
+
+void worker::cancel()
+  {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _waiting = job();
+  if (_running)
+    _running->cancel();
+  }
+
+bool worker::finish_jobs()
+  {
+  std::deque<completion> finished;
+    {
+    std::lock_guard<std::mutex> lock(_mutex);
+    finished.swap(_finished);
+    }
+  for (auto& c : finished)
+    {
+    if (c)
+      c();
+    }
+  return !finished.empty();
+  }
+
+bool worker::busy() const
+  {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _waiting || _running;
+  }
+
+double worker::progress() const
+  {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _running ? _running->progress() : 0.0;
+  }
+
+void worker::_run()
+  {
+  for (;;)
+    {
+    job j;
+    std::shared_ptr<job_state> state;
+      {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _wake.wait(lock, [this]() { return _stop || _waiting; });
+      if (_stop)
+        return;
+      j = std::move(_waiting);
+      _waiting = job();
+      state = std::make_shared<job_state>();
+      _running = state;
+      }
+    completion c;
+    try
+      {
+      c = j(*state);
+      }
+    catch (job_cancelled)
+      {
+      }
+    catch (std::exception& e)
+      {
+      Logging::Error() << e.what() << "\n";
+      }
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (c)
+      _finished.push_back(std::move(c));
+    _running.reset();
+    }
+  }
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+/*
+A background thread for the long computations of the viewer.
+
+A job runs on the worker thread and returns a completion, which finish_jobs runs afterwards on the thread that owns
+the window (and the OpenGL context), so results are handed over there. Submitting a job cancels the job that is
+running and replaces the one that is waiting: only the newest request matters. A job looks at its job_state now and
+then: report sets the progress and throws job_cancelled once the job has been superseded, so the job unwinds at that
+point and has no completion. A job that did finish always gets its completion run.
+*/
+
+struct job_cancelled {};
+
+class job_state
+  {
+  public:
+    job_state() : _cancelled(false), _progress(0.0) {}
+
+    // sets the progress in [0, 1], throws job_cancelled if the job was superseded
+    void report(double progress)
+      {
+      _progress = progress;
+      if (_cancelled)
+        throw job_cancelled();
+      }
+
+    void cancel() { _cancelled = true; }
+    bool cancelled() const { return _cancelled; }
+    double progress() const { return _progress; }
+
+  private:
+    std::atomic<bool> _cancelled;
+    std::atomic<double> _progress;
+  };
+
+class worker
+  {
+  public:
+    typedef std::function<void()> completion;
+    typedef std::function<completion(job_state&)> job;
+
+    worker();
+    ~worker();
+    worker(const worker&) = delete;
+    worker& operator = (const worker&) = delete;
+
+    // runs j on the worker thread, the running job is cancelled and a waiting job is dropped
+    void submit(job j);
+    void cancel();
+
+    // runs the completions of the finished jobs, call from the thread that owns the window. Returns true if there were any.
+    bool finish_jobs();
+
+    // true while a job is waiting or running
+    bool busy() const;
+    // progress of the running job
+    double progress() const;
+
+  private:
+    void _run();
+
+  private:
+    mutable std::mutex _mutex;
+    std::condition_variable _wake;
+    job _waiting;
+    std::shared_ptr<job_state> _running;
+    std::deque<completion> _finished;
+    bool _stop;
+    std::thread _thread;
+  };